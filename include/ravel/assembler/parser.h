@@ -1,7 +1,9 @@
 #pragma once
 
+#include <initializer_list>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -10,17 +12,29 @@
 // utilities
 namespace ravel {
 
-std::string strip(std::string str);
+std::string_view strip(std::string_view str);
 
 // split a string into words
 std::vector<std::string> split(const std::string &s,
                                const std::string &delimiters = " \t");
 
-std::vector<std::string> tokenize(const std::string &line);
+// The same as split(), but the words point into `s`
+std::vector<std::string_view> splitView(std::string_view s,
+                                        std::string_view delimiters = " \t");
 
-bool isDirective(const std::string &str);
+// The words point into `line`
+std::vector<std::string_view> tokenize(std::string_view line);
 
-bool isLabel(const std::string &str);
+// The same as above, but the words are stored into `tokens`, so that its
+// storage can be reused
+void tokenize(std::string_view line, std::vector<std::string_view> &tokens);
+
+// Concatenate `parts` with a single allocation
+std::string concat(std::initializer_list<std::string_view> parts);
+
+bool isDirective(std::string_view str);
+
+bool isLabel(std::string_view str);
 
 // If [line] emits or makes current a new section, then return
 // the name of the section
@@ -28,21 +42,21 @@ std::optional<std::string> getSectionName(const std::string &line);
 
 std::string opType2Name(inst::Instruction::OpType op);
 
-inst::Instruction::OpType name2OpType(std::string name);
+inst::Instruction::OpType name2OpType(std::string_view name);
 
-std::size_t regName2regNumber(const std::string &name);
+std::size_t regName2regNumber(std::string_view name);
 
 std::string regNumber2regName(const std::size_t &num);
 
-std::pair<std::size_t, int> parseBaseOffset(const std::string &str);
+std::pair<std::size_t, int> parseBaseOffset(std::string_view str);
 
 std::string toString(const std::shared_ptr<inst::Instruction> &inst);
 
 // return the section name (e.g. .text)
-std::string parseSectionDerivative(const std::string &line);
+std::string parseSectionDerivative(std::string_view line);
 
-std::uint32_t parseImm(const std::string &str);
+std::uint32_t parseImm(std::string_view str);
 
-std::string handleEscapeCharacters(const std::string &str);
+std::string handleEscapeCharacters(std::string_view str);
 
 } // namespace ravel
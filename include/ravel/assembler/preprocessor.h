@@ -1,16 +1,49 @@
 #pragma once
 
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ravel {
 
-// Split the source file into lines.
+// Stores strings in chunks which never move, so that the views of them stay
+// valid as long as the arena lives
+class StringArena {
+public:
+  // Store the concatenation of `parts`
+  std::string_view concat(std::initializer_list<std::string_view> parts);
+
+private:
+  static constexpr std::size_t ChunkSize = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> chunks;
+  // of the last chunk
+  std::size_t capacity = 0;
+  std::size_t used = 0;
+};
+
+// The statements of a source file, cf. preprocess(). Each statement points
+// into the source, or into `expansions` if it comes from a pseudo
+// instruction, so the source must outlive them.
+struct PreprocessedSource {
+  std::vector<std::string_view> statements;
+  StringArena expansions;
+};
+
+// Split the source file into lines, in a single pass.
 // Remove comments.
 // Trim each line.
 // Make each label to occupy an entire line.
 // Remove empty lines.
 // Translate pseudo instructions.
-std::vector<std::string> preprocess(const std::string &src);
+PreprocessedSource preprocess(const std::string &src);
+// the statements would point into the temporary
+PreprocessedSource preprocess(std::string &&src) = delete;
+
+// Whether `label` was added by preprocess() for a pseudo instruction
+bool isPseudoInstLabel(const std::string &label);
 
 } // namespace ravel
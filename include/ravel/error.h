@@ -51,6 +51,12 @@ public:
     msg = ss.str();
   }
 
+  InvalidAddress(std::size_t address, std::size_t pc) : Exception("") {
+    std::stringstream ss;
+    ss << std::hex << address << " (pc = " << pc << ")";
+    msg = ss.str();
+  }
+
   const char *what() const noexcept override { return msg.c_str(); }
 
 private:
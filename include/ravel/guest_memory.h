@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace ravel {
+
+// The storage of the simulated program, zero-initialized.
+//
+// If `lazy` is set and mmap is available, the storage is an anonymous mapping
+// whose pages are only allocated (and zeroed) by the OS when the program
+// touches them, so a run only pays for its working set. Otherwise it is a
+// std::vector, which zeroes the whole storage up front.
+//
+// If `guarded` is set as well, the storage is surrounded by inaccessible
+// guard regions which cover every address `begin() + x` for a 32-bit `x`.
+// Hence a guest access outside the storage faults, and the fault can be
+// caught with runGuarded() instead of checking every access explicitly.
+// isGuarded() tells whether this is actually the case.
+class GuestMemory {
+public:
+  GuestMemory(std::size_t size, bool lazy, bool guarded = false);
+  GuestMemory(const GuestMemory &) = delete;
+  GuestMemory &operator=(const GuestMemory &) = delete;
+  ~GuestMemory();
+
+  std::byte *begin() const { return storageBegin; }
+  std::byte *end() const { return storageBegin + size; }
+
+  bool isLazy() const { return mapping; }
+
+  bool isGuarded() const { return guarded; }
+
+private:
+  bool mapGuarded();
+
+private:
+  std::byte *storageBegin = nullptr;
+  std::size_t size = 0;
+  // the whole mapping, including the guard regions
+  std::byte *mapping = nullptr;
+  std::size_t mappingSize = 0;
+  bool guarded = false;
+  std::vector<std::byte> fallback;
+};
+
+// Call `func(context)`. If it accesses a guard region of a guarded
+// GuestMemory, it is abandoned and the faulting host address is returned.
+// No destructors are run then, so wherever `func` may fault, only trivially
+// destructible objects may be alive in it and in the functions it is called
+// from. Code which owns more, e.g. the simulated libc, must run in an
+// UnguardedScope.
+std::optional<std::byte *> runGuarded(void (*func)(void *), void *context);
+
+// While an UnguardedScope is alive, faults are not caught by the enclosing
+// runGuarded(), but are fatal as without it.
+class UnguardedScope {
+public:
+  UnguardedScope();
+  UnguardedScope(const UnguardedScope &) = delete;
+  UnguardedScope &operator=(const UnguardedScope &) = delete;
+  ~UnguardedScope();
+
+private:
+  void *previous = nullptr;
+};
+
+} // namespace ravel
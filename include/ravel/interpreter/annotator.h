@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+#include "block_cache.h"
+#include "decoder.h"
+#include "profiler.h"
+#include "ravel/linker/interpretable.h"
+
+namespace ravel {
+
+// Counts the executions and the costs of the basic blocks, and annotates the
+// assembly with them, cf. Interpreter::enableAnnotation().
+//
+// Like Profiler, the costs are attributed as the differences of the running
+// totals, so the interpreter only tells the annotator where each block (or
+// each instruction run on its own) starts. A call to the C library is
+// attributed to the block which calls it.
+class Annotator {
+public:
+  // the cost of an instruction, other than its memory access
+  using InstCost = std::function<std::size_t(const DecodedInst &)>;
+
+  Annotator(const Interpretable &interpretable,
+            const std::vector<DecodedInst> &decodedInsts,
+            const BasicBlockCache &blockCache)
+      : interpretable(interpretable), decodedInsts(decodedInsts),
+        blockCache(blockCache), slots(decodedInsts.size()) {}
+
+  // A block starts at `pc`. `totals` are the running totals of the costs.
+  void enterBlock(std::uint32_t pc, const Profiler::Counters &totals) {
+    flush(totals);
+    current = pc / 4;
+    ++slots[current].blockCount;
+  }
+
+  // The same as enterBlock(), but only the instruction at `pc` is run
+  void enterInst(std::uint32_t pc, const Profiler::Counters &totals) {
+    if (Interpretable::LibcFuncStart <= pc && pc < Interpretable::LibcFuncEnd)
+      return;
+    flush(totals);
+    current = pc / 4;
+    ++slots[current].instCount;
+  }
+
+  void finish(const Profiler::Counters &totals) { flush(totals); }
+
+  // Write the instructions with their comments and labels, annotated with
+  // the # of executions and the share of `totalTime`, where an instruction
+  // costs `instCost` per execution. The first instruction of each block is
+  // annotated with the L1 hits and the accesses missing in every cache level
+  // of the block as well. The other costs of the block, i.e. those of `time`
+  // but the instructions themselves, count towards its share.
+  void print(std::ostream &os, const InstCost &instCost,
+             const Profiler::TimeFunc &time, std::size_t totalTime) const;
+
+private:
+  void flush(const Profiler::Counters &totals) {
+    slots[current].counters.addDifference(totals, last);
+    last = totals;
+  }
+
+private:
+  const Interpretable &interpretable;
+  const std::vector<DecodedInst> &decodedInsts;
+  const BasicBlockCache &blockCache;
+
+  struct Slot {
+    // the # of times a block, or the instruction alone, started here
+    std::size_t blockCount = 0;
+    std::size_t instCount = 0;
+    // the costs of the blocks or instructions started here
+    Profiler::Counters counters;
+  };
+  std::vector<Slot> slots; // indexed by pc / 4
+  std::size_t current = 0;
+  Profiler::Counters last;
+};
+
+} // namespace ravel
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "decoder.h"
+
+namespace ravel {
+
+// A straight-line sequence of decoded instructions. Only the last instruction
+// of a block may transfer control or write to x0, so the interpreter can do
+// its bookkeeping (counting instructions, checking the timeout, resetting x0)
+// once per block.
+//
+// Whether a block ends at an instruction only depends on the instruction
+// itself and whether its successor is a valid instruction (cf.
+// `BasicBlockCache::endsBlock()`). Hence overlapping blocks end at the same
+// place.
+struct BasicBlock {
+  std::uint32_t entry = 0; // the address of the first instruction
+  std::vector<DecodedInst> insts;
+
+  // the number of instructions of each type, cf. InstCnt
+  std::size_t simple = 0;
+  std::size_t mul = 0;
+  std::size_t br = 0;
+  std::size_t div = 0;
+};
+
+// Basic blocks keyed by their entry address. Blocks are built on first use
+// and may overlap, e.g. when a jump targets the middle of another block.
+class BasicBlockCache {
+public:
+  explicit BasicBlockCache(const std::vector<DecodedInst> &decodedInsts)
+      : decodedInsts(decodedInsts), slot2Block(decodedInsts.size(), 0) {}
+
+  // Return the block starting at `pc`, or nullptr if there is no valid
+  // instruction at `pc` or `pc` is reserved for the interpreter (cf.
+  // `Interpretable`). `pc` must be 4-byte aligned.
+  const BasicBlock *get(std::uint32_t pc) {
+    auto slot = pc / 4;
+    if (slot >= slot2Block.size())
+      return nullptr;
+    if (slot2Block[slot] == 0)
+      build(slot);
+    auto idx = slot2Block[slot];
+    return idx == NoBlock ? nullptr : &blocks[idx - 1];
+  }
+
+  // Whether the instruction in `slot` (i.e. at `slot * 4`) is the last one
+  // of the blocks containing it. Only meaningful if there is a valid
+  // instruction in `slot`.
+  bool endsBlock(std::size_t slot) const;
+
+  // Whether `slot` may start a block
+  bool isValid(std::size_t slot) const;
+
+private:
+  void build(std::size_t slot);
+
+private:
+  static constexpr std::uint32_t NoBlock = -1;
+
+  const std::vector<DecodedInst> &decodedInsts;
+  // 0: not built yet; NoBlock: no block starts here; otherwise 1 + the index
+  // of the block in `blocks`
+  std::vector<std::uint32_t> slot2Block;
+  std::deque<BasicBlock> blocks;
+};
+
+} // namespace ravel
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace ravel {
+
+enum class BranchPredictorKind {
+  StaticNotTaken,
+  // a table of 2-bit saturating counters indexed by the pc
+  Bimodal,
+  // the same, but indexed by the pc xor the global history
+  Gshare,
+};
+
+struct BranchPredictorConfig {
+  BranchPredictorConfig() = default;
+
+  BranchPredictorKind kind = BranchPredictorKind::Bimodal;
+  // log2 of the # of counters
+  std::size_t tableBits = 12;
+  // the # of outcomes in the global history, for gshare
+  std::size_t historyBits = 12;
+  // the # of entries of the (direct mapped) branch target buffer used for
+  // JALR, which must be a power of two
+  std::size_t btbEntries = 512;
+};
+
+// Predicts the conditional branches and the targets of JALR. JAL is always
+// predicted correctly. Besides the # of mispredictions, the outcomes are
+// recorded per branch, cf. printStats().
+class BranchPredictor {
+public:
+  // `numSlots` is the # of instruction slots, i.e. the size of the program
+  // divided by 4
+  BranchPredictor(const BranchPredictorConfig &config, std::size_t numSlots);
+
+  // Record a conditional branch at `pc`. Return whether it was mispredicted.
+  bool branch(std::uint32_t pc, bool taken);
+
+  // Record a JALR at `pc`. Return whether the target was mispredicted.
+  bool jump(std::uint32_t pc, std::uint32_t target);
+
+  std::size_t getMispredictions() const { return mispredictions; }
+
+  // Write the statistics of every executed branch and JALR as CSV
+  void printStats(std::ostream &os) const;
+
+private:
+  bool predict(std::uint32_t pc) const;
+
+  void update(std::uint32_t pc, bool taken);
+
+  std::size_t getCounterIndex(std::uint32_t pc) const;
+
+private:
+  BranchPredictorConfig config;
+  std::vector<std::uint8_t> counters;
+  std::uint32_t history = 0;
+  struct BtbEntry {
+    std::uint32_t pc = 0;
+    std::uint32_t target = 0;
+    bool valid = false;
+  };
+  std::vector<BtbEntry> btb;
+
+  struct Stats {
+    std::size_t executed = 0;
+    std::size_t taken = 0;
+    std::size_t mispredicted = 0;
+  };
+  std::vector<Stats> stats; // indexed by pc / 4
+  std::size_t mispredictions = 0;
+};
+
+} // namespace ravel
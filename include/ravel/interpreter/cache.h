@@ -7,30 +7,211 @@
 #include <utility>
 #include <vector>
 
+#include "miss_ratio_curve.h"
+#include "prefetcher.h"
+#include "trace_ring.h"
+#include "ravel/error.h"
+
 namespace ravel {
 
-class Cache {
+enum class ReplacementPolicy {
+  // Evict the last line which has not been used for 32 cycles, or the first
+  // line of the set if there is none. This is what the original fully
+  // associative cache did.
+  Idle,
+  Lru,
+  Fifo,
+  Random,
+};
+
+struct CacheConfig {
+  CacheConfig() = default;
+
+  // `sets` and `lineSize` must be powers of two
+  std::size_t sets = 1;
+  std::size_t ways = 16;
+  std::size_t lineSize = 64;
+  ReplacementPolicy policy = ReplacementPolicy::Idle;
+  // The cost of a hit. Only used for the levels below L1, whose hits are
+  // counted separately (cf. InstCnt::lowerCache). The cost of an L1 hit is
+  // InstWeight::cache, and that of a miss in all levels is InstWeight::mem.
+  std::size_t latency = 16;
+};
+
+enum class InclusionPolicy {
+  // A line in a level is also in all the levels below it. Evicting a line
+  // evicts it from the levels above as well.
+  Inclusive,
+  // A line is in at most one level. Lines are only filled into L1, and a
+  // line evicted from a level moves to the level below it. All the levels
+  // must have the same line size.
+  Exclusive,
+};
+
+// A single level of the cache hierarchy. It only keeps track of which lines
+// are present, since the data always come from the storage.
+class CacheLevel {
   struct Line;
 
+public:
+  explicit CacheLevel(const CacheConfig &config);
+
+  const CacheConfig &getConfig() const { return config; }
+
+  // Look up the line containing `addr` and count the hit or miss
+  bool lookup(std::size_t addr, std::size_t cycles, std::size_t accesses);
+
+  // Whether the line containing `addr` is present. Nothing is counted.
+  bool contains(std::size_t addr);
+
+  // Insert the line containing `addr`, which must not be present. Return the
+  // address of the evicted line, if any.
+  std::optional<std::size_t> insert(std::size_t addr, std::size_t cycles,
+                                    std::size_t accesses,
+                                    bool prefetched = false);
+
+  void invalidate(std::size_t addr);
+
+  std::pair<std::size_t, std::size_t> getHitMiss() const { return {hit, miss}; }
+
+  // the # of prefetched lines which were hit before being evicted
+  std::size_t getUsefulPrefetches() const { return usefulPrefetches; }
+
+private:
+  Line *getSet(std::size_t tag) { return lines.data() + (tag & setMask) * ways; }
+
+  // Return the line of the set starting at `set` to be replaced
+  Line &getVictim(Line *set, std::size_t cycles);
+
+private:
+  CacheConfig config;
+  struct Line {
+    std::size_t tag = 0; // the address divided by the line size
+    std::size_t lastUsed = 0;
+    std::size_t lastAccess = 0;
+    std::size_t filled = 0;
+    bool valid = false;
+    // prefetched and not hit yet
+    bool prefetched = false;
+  };
+  // the ways of set i are lines[i * ways, (i + 1) * ways)
+  std::vector<Line> lines;
+  std::size_t ways = 0;
+  std::size_t lineSizePow = 0;
+  std::size_t setMask = 0;
+  std::uint32_t randomState = 0x9e3779b9;
+
+  std::size_t hit = 0;
+  std::size_t miss = 0;
+  std::size_t usefulPrefetches = 0;
+};
+
+// The instruction cache, which is separate from the data cache and fed by
+// instruction fetches. Its clock counts fetches, so that fetching a whole
+// basic block at once leaves it in the same state as fetching the
+// instructions one by one.
+class InstCache {
+public:
+  explicit InstCache(const CacheConfig &config) : level(config) {}
+
+  // Fetch the `n` consecutive instructions starting at `pc`
+  void fetch(std::size_t pc, std::size_t n = 1);
+
+  std::pair<std::size_t, std::size_t> getHitMiss() const { return {hit, miss}; }
+
+private:
+  CacheLevel level;
+  std::size_t fetches = 0;
+
+  std::size_t hit = 0;
+  std::size_t miss = 0;
+};
+
+// The cache hierarchy, L1 first, in front of the storage
+class Cache {
 public:
   Cache(std::byte *storageBegin, std::byte *storageEnd)
       : storageBegin(storageBegin), storageEnd(storageEnd) {
     assert(storageEnd >= storageBegin);
-    lines.resize(16);
+    configure({CacheConfig()});
+  }
+
+  // Change the levels and the inclusion policy. All lines are invalidated,
+  // and the prefetcher is removed.
+  void configure(const std::vector<CacheConfig> &configs,
+                 InclusionPolicy inclusion = InclusionPolicy::Inclusive);
+
+  // Prefetch lines into L1 on every access, cf. Prefetcher. The prefetches
+  // are counted by getPrefetches() only.
+  void setPrefetcher(const PrefetcherConfig &config) {
+    prefetcher.emplace(config, levels.front().getConfig().lineSize);
+  }
+
+  bool hasPrefetcher() const { return prefetcher.has_value(); }
+
+  // The # of prefetches issued and the # of those which were useful, i.e.
+  // hit before being evicted
+  std::pair<std::size_t, std::size_t> getPrefetches() const {
+    return {prefetches, levels.front().getUsefulPrefetches()};
   }
 
-  void tick() { ++cycles; }
+  void tick(std::size_t n = 1) { cycles += n; }
 
+  std::uint32_t fetchWord(std::size_t addr) {
+    return disabled ? fetchWord<false>(addr) : fetchWord<true>(addr);
+  }
+
+  // The same as fetchWord(std::size_t), but for a cache known to be enabled
+  // or disabled. `Enabled` must agree with isEnabled(). If `Checked` is
+  // false, `addr` is not checked against the size of the storage, and the
+  // caller is responsible for catching the fault (cf. GuestMemory).
+  template <bool Enabled, bool Checked = true>
   std::uint32_t fetchWord(std::size_t addr);
 
   void disable() { disabled = true; }
 
+  bool isEnabled() const { return !disabled; }
+
   std::pair<std::byte *, std::byte *> getMemory() {
     return {storageBegin, storageEnd};
   }
 
+  // The # of L1 hits and the # of accesses which missed in all levels
   std::pair<std::size_t, std::size_t> getHitMiss() const { return {hit, miss}; }
 
+  const std::vector<CacheLevel> &getLevels() const { return levels; }
+
+  // Feed every access to `curve` as well, even if the cache is disabled
+  void setMissRatioCurve(MissRatioCurve *curve) {
+    missRatioCurve = curve;
+    observed = true;
+  }
+
+  // Forward every access to `ring` instead of simulating it, or stop doing so
+  // if `ring` is nullptr. The consumer of the ring replays the accesses on
+  // a copy of this cache, cf. replay().
+  void forwardTo(TraceRing *newRing) {
+    ring = newRing;
+    observed = ring || missRatioCurve || !followers.empty();
+  }
+
+  bool isForwarding() const { return ring; }
+
+  // Simulate an access forwarded by another cache
+  void replay(const TraceEvent &event) {
+    cycles = event.cycles;
+    if (observed)
+      notifyObservers(event.addr);
+    access(event.addr);
+  }
+
+  // Feed every access to `other` as well, at the same cycle, so that its
+  // counters are those `other` would have in place of this cache
+  void addFollower(Cache *other) {
+    followers.emplace_back(other);
+    observed = true;
+  }
+
   std::byte &operator[](std::size_t addr) {
     fetchWord(addr);
     assert(addr < std::size_t(storageEnd - storageBegin));
@@ -40,27 +221,106 @@ public:
   std::size_t storageSize() const { return storageEnd - storageBegin; }
 
 private:
-  Line &getEmptyLine();
+  // Count an access, whose address has been checked
+  void access(std::size_t addr) {
+    if (disabled) {
+      miss++;
+      return;
+    }
+    ++accesses;
+    if (levels.front().lookup(addr, cycles, accesses))
+      hit++;
+    else
+      fetchFromLowerLevels(addr);
+    if (prefetcher)
+      prefetch(addr);
+  }
 
-private:
-  static constexpr std::size_t SizePow = 6;
-  static constexpr std::uint32_t Mask = std::uint32_t(-1) << SizePow;
+  // Handle an access which missed in L1
+  void fetchFromLowerLevels(std::size_t addr);
 
+  // Fill the line containing `addr` into L1 from levels[found], or from the
+  // storage if `found` is the # of levels
+  void fill(std::size_t addr, std::size_t found, bool prefetched);
+
+  // Issue the prefetches triggered by an access to `addr`
+  void prefetch(std::size_t addr);
+
+  // Feed an access to the miss ratio curve and the followers
+  void notifyObservers(std::size_t addr);
+
+private:
   std::byte *const storageBegin;
   std::byte *const storageEnd;
 
   std::size_t cycles = 32;
-  struct Line {
-    std::size_t addr = 0;
-    std::size_t lastUsed = 0;
-    bool valid = false;
-  };
-  std::vector<Line> lines;
+  std::vector<CacheLevel> levels;
+  MissRatioCurve *missRatioCurve = nullptr;
+  std::vector<Cache *> followers;
+  TraceRing *ring = nullptr;
+  std::optional<Prefetcher> prefetcher;
+  // whether there is a miss ratio curve, a follower or a ring
+  bool observed = false;
+  InclusionPolicy inclusion = InclusionPolicy::Inclusive;
   bool disabled = false;
-  std::size_t victimIdx = 7;
+  // The number of accesses. Unlike `cycles`, this distinguishes the accesses
+  // made by a single instruction.
+  std::size_t accesses = 0;
 
   std::size_t hit = 0;
   std::size_t miss = 0;
+  std::size_t prefetches = 0;
 };
 
-} // namespace ravel
\ No newline at end of file
+inline bool CacheLevel::lookup(std::size_t addr, std::size_t cycles,
+                               std::size_t accesses) {
+  auto tag = addr >> lineSizePow;
+  auto set = getSet(tag);
+  for (std::size_t i = 0; i < ways; ++i) {
+    auto &line = set[i];
+    if (!line.valid || line.tag != tag)
+      continue;
+    line.lastUsed = cycles;
+    line.lastAccess = accesses;
+    if (line.prefetched) {
+      line.prefetched = false;
+      ++usefulPrefetches;
+    }
+    hit++;
+    return true;
+  }
+  miss++;
+  return false;
+}
+
+template <bool Enabled, bool Checked>
+std::uint32_t Cache::fetchWord(std::size_t addr) {
+  assert(Enabled == !disabled);
+  if constexpr (Checked) {
+    std::size_t memorySize = storageEnd - storageBegin;
+    if (addr + 4 > memorySize) {
+      throw InvalidAddress(addr);
+    }
+  }
+  if (observed) {
+    if (ring) {
+      ring->push({cycles, (std::uint32_t)addr});
+      return *(std::uint32_t *)(storageBegin + addr);
+    }
+    notifyObservers(addr);
+  }
+  if constexpr (!Enabled) {
+    miss++;
+    return *(std::uint32_t *)(storageBegin + addr);
+  }
+  ++accesses;
+  if (levels.front().lookup(addr, cycles, accesses))
+    hit++;
+  else
+    fetchFromLowerLevels(addr);
+  if (prefetcher)
+    prefetch(addr);
+  return *(std::uint32_t *)(storageBegin + addr);
+}
+
+} // namespace ravel
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ravel/instructions.h"
+#include "ravel/linker/interpretable.h"
+
+namespace ravel {
+
+// A compact, pre-decoded form of `inst::Instruction`. The interpreter runs
+// off a flat array of these, indexed by `pc >> 2`, instead of following a
+// `std::shared_ptr` for every executed instruction.
+//
+// Field usage by instruction type:
+//   ImmConstruction: rd,           imm = the immediate shifted left by 12
+//   JumpLink:        rd,           imm = byte offset
+//   JumpLinkReg:     rd, rs1,      imm = offset
+//   Branch:              rs1, rs2, imm = offset
+//   MemAccess:       loads:  rd, rs1 (base), imm = offset
+//                    stores: rs1 (base), rs2 (value), imm = offset
+//   ArithRegImm:     rd, rs1,      imm
+//   ArithRegReg:     rd, rs1, rs2
+//   MArith:          rd, rs1, rs2
+// Unused fields are zero.
+struct DecodedInst {
+  // `op` of a slot which does not hold an instruction
+  static constexpr std::uint8_t Invalid = 0xff;
+
+  std::uint8_t op = Invalid; // inst::Instruction::OpType
+  std::uint8_t rd = 0;
+  std::uint8_t rs1 = 0;
+  std::uint8_t rs2 = 0;
+  std::int32_t imm = 0;
+};
+static_assert(sizeof(DecodedInst) == 8);
+
+// The counter of InstCnt an instruction is counted in. Memory accesses are
+// counted by the cache instead.
+enum class InstClass { Simple, Mul, Div, Branch, MemAccess };
+
+inline InstClass getInstClass(const DecodedInst &inst) {
+  using Op = inst::Instruction::OpType;
+  auto op = (Op)inst.op;
+  if (Op::MUL <= op && op <= Op::MULHU)
+    return InstClass::Mul;
+  if (Op::DIV <= op && op <= Op::REMU)
+    return InstClass::Div;
+  if (Op::BEQ <= op && op <= Op::BGEU)
+    return InstClass::Branch;
+  if (Op::LB <= op && op <= Op::SW)
+    return InstClass::MemAccess;
+  return InstClass::Simple;
+}
+
+DecodedInst decode(const inst::Instruction &inst);
+
+// Lower every instruction of `interpretable` into a table indexed by
+// `address >> 2`. Slots which do not hold an instruction are `Invalid`.
+std::vector<DecodedInst> decode(const Interpretable &interpretable);
+
+} // namespace ravel
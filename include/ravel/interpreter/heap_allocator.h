@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+namespace ravel {
+
+// The allocator behind the simulated malloc and free. All the metadata lives
+// on the host, so the guest only sees the blocks themselves.
+//
+// Every block is followed by a red zone of one or two bytes which makes its
+// end even. Free blocks are kept in segregated lists, one per power of two,
+// and coalesced with their neighbours on free. A request is served by the
+// smallest free block which fits (the lowest address among equals), which is
+// split if necessary. Only if there is none is the heap extended, in which
+// case the block is placed exactly where a bump allocator would place it.
+// Hence a program which never frees sees the same addresses as with a bump
+// allocator, and the layout is deterministic in general.
+class HeapAllocator {
+public:
+  struct Block {
+    std::size_t addr = 0;
+    std::size_t size = 0; // as requested
+    std::size_t end = 0;  // the end of the red zone
+  };
+
+  // Start a new heap at `heapBegin`
+  void reset(std::size_t heapBegin);
+
+  Block allocate(std::size_t size);
+
+  // Return the freed block, or std::nullopt if no block starts at `addr`
+  std::optional<Block> deallocate(std::size_t addr);
+
+  // The end of the heap
+  std::size_t getTop() const { return top; }
+
+  // The highest end the heap has reached
+  std::size_t getPeakTop() const { return peakTop; }
+
+  // Whether there is an allocated block
+  bool hasAllocated() const { return !allocated.empty(); }
+
+private:
+  static constexpr std::size_t NumBins = 8 * sizeof(std::size_t);
+
+  static std::size_t binOf(std::size_t size);
+
+  static std::size_t getEnd(std::size_t addr, std::size_t size);
+
+  void insertFree(std::size_t addr, std::size_t size);
+
+  void eraseFree(std::size_t addr, std::size_t size);
+
+private:
+  std::size_t top = 0;
+  std::size_t peakTop = 0;
+  std::unordered_map<std::size_t, Block> allocated;
+  // addr -> size
+  std::map<std::size_t, std::size_t> freeBlocks;
+  // (size, addr) of the free blocks whose size is in [2^i, 2^(i+1))
+  std::array<std::set<std::pair<std::size_t, std::size_t>>, NumBins> bins;
+};
+
+} // namespace ravel
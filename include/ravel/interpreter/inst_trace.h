@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ravel {
+
+// The binary trace of the executed instructions, written by InstTraceWriter
+// and read by InstTraceReader (cf. the ravel-trace tool).
+//
+// File format (little endian):
+//   "RAVELTR1"
+//   u32 flags (inst_trace::Compressed)
+//   u32 # of symbols, followed by each symbol as
+//     u32 address, u32 length of the name, the name
+//   blocks, each of which is
+//     u32 size of the records, u32 size stored, the records (compressed if
+//     inst_trace::Compressed)
+//
+// Each record starts with a byte of record flags, followed by
+//   if Jump: varint zigzag(pc - (the previous pc + 4))
+//   if Mem:  varint zigzag(the address - the previous address)
+//   if Reg:  u8 register, varint the value written
+// The previous pc and address are 0 at the start of each block, so that the
+// blocks can be decoded independently.
+namespace inst_trace {
+
+// the flags of the file
+constexpr std::uint32_t Compressed = 1;
+
+// the flags of a record
+constexpr std::uint8_t Jump = 1;
+constexpr std::uint8_t Mem = 2;
+constexpr std::uint8_t Reg = 4;
+
+// the size of the records of a block, except for the last record
+constexpr std::size_t BlockSize = 1 << 20;
+
+} // namespace inst_trace
+
+// An executed instruction
+struct InstTraceRecord {
+  std::uint32_t pc = 0;
+  bool hasAddr = false;
+  std::uint32_t addr = 0; // the address loaded from or stored to
+  bool hasReg = false;
+  std::uint8_t reg = 0;
+  std::uint32_t value = 0; // the value written to `reg`
+};
+
+class InstTraceWriter {
+public:
+  // Write the trace to `fileName`. Every symbol of `symbols` not starting
+  // with '.' is recorded, so that the reader can tell the functions.
+  InstTraceWriter(const std::string &fileName, bool compress,
+                  const std::vector<std::pair<std::string, std::size_t>>
+                      &symbols);
+
+  InstTraceWriter(const InstTraceWriter &) = delete;
+  InstTraceWriter &operator=(const InstTraceWriter &) = delete;
+
+  // Write the last block and close the file
+  ~InstTraceWriter();
+
+  // Start the record of the instruction at `pc`
+  void begin(std::uint32_t pc) {
+    if (size >= inst_trace::BlockSize)
+      flushBlock();
+    flags = size++;
+    buffer[flags] = 0;
+    if (pc != lastPc + 4) {
+      buffer[flags] |= inst_trace::Jump;
+      writeVarint(zigzag(std::int64_t(pc) - std::int64_t(lastPc + 4)));
+    }
+    lastPc = pc;
+  }
+
+  // The instruction of the current record accesses `addr`
+  void memAccess(std::uint32_t addr) {
+    buffer[flags] |= inst_trace::Mem;
+    writeVarint(zigzag(std::int64_t(addr) - std::int64_t(lastAddr)));
+    lastAddr = addr;
+  }
+
+  // The instruction of the current record writes `value` to `reg`
+  void regWrite(std::uint8_t reg, std::uint32_t value) {
+    buffer[flags] |= inst_trace::Reg;
+    buffer[size++] = reg;
+    writeVarint(value);
+  }
+
+private:
+  // the size of the longest record
+  static constexpr std::size_t MaxRecordSize = 1 + 10 + 10 + 1 + 5;
+
+  static std::uint64_t zigzag(std::int64_t n) {
+    return (std::uint64_t(n) << 1u) ^ std::uint64_t(n >> 63);
+  }
+
+  void writeVarint(std::uint64_t n) {
+    while (n >= 0x80) {
+      buffer[size++] = std::uint8_t(n | 0x80);
+      n >>= 7u;
+    }
+    buffer[size++] = std::uint8_t(n);
+  }
+
+  void flushBlock();
+
+  void write(const void *data, std::size_t n);
+
+private:
+  FILE *file;
+  bool compress;
+  std::vector<std::uint8_t> buffer;
+  std::vector<std::uint8_t> compressed;
+  std::size_t size = 0;
+  std::size_t flags = 0; // the position of the flags of the current record
+  std::uint32_t lastPc = 0;
+  std::uint32_t lastAddr = 0;
+};
+
+class InstTraceReader {
+public:
+  explicit InstTraceReader(const std::string &fileName);
+
+  InstTraceReader(const InstTraceReader &) = delete;
+  InstTraceReader &operator=(const InstTraceReader &) = delete;
+
+  ~InstTraceReader();
+
+  // Read the next record. Return false at the end of the trace.
+  bool next(InstTraceRecord &record);
+
+  // the symbols recorded, sorted by address
+  const std::vector<std::pair<std::string, std::uint32_t>> &
+  getSymbols() const {
+    return symbols;
+  }
+
+  // The name of the function containing `pc`, i.e. the last symbol at or
+  // before `pc`, and the offset of `pc` in it
+  std::pair<std::string, std::uint32_t> getFunction(std::uint32_t pc) const;
+
+private:
+  bool readBlock();
+
+  void read(void *data, std::size_t n);
+
+  std::uint64_t readVarint();
+
+private:
+  FILE *file;
+  bool compressed = false;
+  std::vector<std::pair<std::string, std::uint32_t>> symbols;
+  std::vector<std::uint8_t> block;
+  std::vector<std::uint8_t> stored;
+  std::size_t pos = 0;
+  std::uint32_t lastPc = 0;
+  std::uint32_t lastAddr = 0;
+};
+
+} // namespace ravel
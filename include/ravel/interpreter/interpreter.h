@@ -5,10 +5,22 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <memory>
+#include <ostream>
 #include <optional>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "annotator.h"
+#include "block_cache.h"
+#include "branch_predictor.h"
 #include "cache.h"
+#include "decoder.h"
+#include "heap_allocator.h"
+#include "inst_trace.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "shadow_memory.h"
 #include "ravel/linker/interpretable.h"
 
 namespace ravel {
@@ -24,6 +36,12 @@ struct InstWeight {
   std::size_t mem = 64;
   std::size_t libcIO = 64;
   std::size_t libcMem = 128;
+  // instruction fetches, if the I-cache is enabled
+  std::size_t icache = 0;
+  std::size_t imem = 64;
+  // the penalty of a mispredicted branch or JALR, if a branch predictor is
+  // enabled
+  std::size_t brMiss = 16;
 };
 
 struct InstCnt {
@@ -35,6 +53,25 @@ struct InstCnt {
   std::size_t mem = 0;
   std::size_t libcIO = 0;
   std::size_t libcMem = 0;
+  // the # of hits in L2, L3, ..., cf. CacheConfig::latency
+  std::vector<std::size_t> lowerCache;
+  // the # of I-cache hits and misses
+  std::size_t icache = 0;
+  std::size_t imem = 0;
+  // the # of mispredicted branches and JALRs
+  std::size_t brMiss = 0;
+};
+
+// A cost model evaluated alongside the main one, cf.
+// Interpreter::addCostModel()
+struct CostModel {
+  CostModel() = default;
+
+  InstWeight instWeight = InstWeight();
+  bool cacheEnabled = true;
+  std::vector<CacheConfig> cacheLevels = {CacheConfig()};
+  InclusionPolicy cacheInclusion = InclusionPolicy::Inclusive;
+  std::optional<PrefetcherConfig> prefetcher;
 };
 
 class Interpreter {
@@ -57,43 +94,289 @@ public:
 
   void disableCache() { cache.disable(); }
 
+  void setCacheConfig(const std::vector<CacheConfig> &levels,
+                      InclusionPolicy inclusion = InclusionPolicy::Inclusive) {
+    cache.configure(levels, inclusion);
+  }
+
+  // Must be called after setCacheConfig(), cf. Cache::setPrefetcher()
+  void setPrefetcher(const PrefetcherConfig &config) {
+    cache.setPrefetcher(config);
+  }
+
+  bool hasPrefetcher() const { return cache.hasPrefetcher(); }
+
+  // cf. Cache::getPrefetches()
+  std::pair<std::size_t, std::size_t> getPrefetches() const {
+    return getTimingCache().getPrefetches();
+  }
+
+  const std::vector<CacheLevel> &getCacheLevels() const {
+    return getTimingCache().getLevels();
+  }
+
+  // Model instruction fetches with an I-cache, cf. InstCache
+  void enableInstCache(const CacheConfig &config) { icache.emplace(config); }
+
+  bool isInstCacheEnabled() const { return icache.has_value(); }
+
+  // Predict branches and charge mispredictions, cf. BranchPredictor
+  void enableBranchPredictor(const BranchPredictorConfig &config) {
+    branchPredictorConfig = config;
+  }
+
+  const std::optional<BranchPredictor> &getBranchPredictor() const {
+    return branchPredictor;
+  }
+
+  // Feed the executed instructions to a pipeline model, cf. PipelineModel.
+  // The model needs every instruction, so neither the threaded engine nor
+  // the JIT nor decoupled timing is used.
+  void enablePipelineModel(const PipelineConfig &config) {
+    pipeline.emplace(config);
+  }
+
+  const std::optional<PipelineModel> &getPipelineModel() const {
+    return pipeline;
+  }
+
+  // Attribute the costs to the functions, cf. Profiler. The profiler needs
+  // every basic block, so neither the threaded engine nor the JIT nor
+  // decoupled timing is used.
+  void enableProfiler() {
+    if (!profiler)
+      profiler.emplace(interpretable);
+  }
+
+  // Attribute the costs to the call paths as well, cf. Profiler
+  void enableCallGraph() {
+    enableProfiler();
+    profiler->enableCallGraph();
+  }
+
+  const std::optional<Profiler> &getProfiler() const { return profiler; }
+
+  // The time consumed by the costs attributed to a function
+  std::size_t getTimeConsumed(const Profiler::Counters &counters) const;
+
+  // Count the executions and the cache accesses of each basic block, cf.
+  // Annotator. Like the profiler, the annotator uses the basic interpreter.
+  void enableAnnotation() { annotate = true; }
+
+  // Write the annotated assembly, cf. Annotator::print()
+  void printAnnotation(std::ostream &os) const;
+
+  // Write the executed instructions to `fileName`, cf. InstTraceWriter.
+  // Like the profiler, tracing uses the basic interpreter.
+  void enableTrace(const std::string &fileName, bool compress) {
+    tracer.emplace(fileName, compress, interpretable.getSymbols());
+  }
+
+  // Compute the miss ratio curve of the data accesses, cf. MissRatioCurve
+  void enableMissRatioCurve(std::size_t lineSize, std::size_t maxLines) {
+    missRatioCurve.emplace(lineSize, maxLines);
+    cache.setMissRatioCurve(&*missRatioCurve);
+  }
+
+  const std::optional<MissRatioCurve> &getMissRatioCurve() const {
+    return missRatioCurve;
+  }
+
   void setKeepDebugInfo(bool val) { keepDebugInfo = val; }
 
   std::uint32_t getReturnCode() const;
 
-  bool hasMemoryLeak() const { return !malloced.empty(); }
+  bool hasMemoryLeak() const { return heap.hasAllocated(); }
+
+  // The peak size of the static data and the heap, in bytes. The stack is
+  // not included.
+  std::size_t getPeakMemory() const { return heap.getPeakTop(); }
 
   std::size_t getTimeConsumed() const {
-    return instCnt.simple * instWeight.simple + instCnt.mul * instWeight.mul +
-           instCnt.cache * instWeight.cache + instCnt.br * instWeight.br +
-           instCnt.div * instWeight.div + instCnt.mem * instWeight.mem +
-           instCnt.libcIO * instWeight.libcIO +
-           instCnt.libcMem * instWeight.libcMem;
+    return computeTime(instCnt, instWeight, getTimingCache());
   }
 
+  // Evaluate `model` in the same run as well. Its cache is fed with the same
+  // accesses as the main one.
+  void addCostModel(const CostModel &model);
+
+  std::size_t getNumCostModels() const { return costModels.size(); }
+
+  // The time consumed under the `i`-th cost model added
+  std::size_t getTimeConsumed(std::size_t i) const;
+
   const InstCnt &getInstCnt() const { return instCnt; }
 
   void enablePrintInstructions() { printInstructions = true; }
 
+  // Use the threaded engine (cf. threaded.cpp) if neither instructions are
+  // printed nor debug info is kept.
+  void enableThreadedDispatch() { threadedDispatch = true; }
+
+  // Translate hot basic blocks into host machine code (cf. jit.h) if neither
+  // instructions are printed nor debug info is kept. Has no effect if the JIT
+  // is not supported.
+  void enableJit() { jit = true; }
+
+  // The storage is a guarded GuestMemory, so out-of-range accesses can be
+  // left to the hardware. Only used if neither instructions are printed nor
+  // debug info is kept, and not by the JIT.
+  void enableGuardPages() { guardPages = true; }
+
+  // Simulate the cache on another thread, which is fed through a TraceRing.
+  // The results are the same.
+  void enableDecoupledTiming() { decoupledTiming = true; }
+
   void setTimeout(std::size_t newTimeout) { timeout = newTimeout; }
 
 private:
   void load();
 
-  void simulate(const std::shared_ptr<inst::Instruction> &inst);
+  // Run the engine chosen by the flags
+  void runEngine();
+
+  // Run the engine with the cache simulated by `timingCache` on another
+  // thread
+  void interpretDecoupled();
+
+  // the cache whose counters are reported
+  const Cache &getTimingCache() const {
+    return timingCache ? *timingCache : cache;
+  }
+
+  // The interpreter loops are specialized on the flags below, which are
+  // chosen once in interpret(), so that the hot loops do not test them.
+  // `CacheEnabled` must agree with `cache.isEnabled()`. If `Guarded` is set,
+  // memory accesses are not checked, and the loop must be run with
+  // interpretGuarded().
+  template <bool PrintInstructions, bool KeepDebugInfo, bool CacheEnabled,
+            bool Guarded>
+  void interpretImpl();
+
+  // Execute `inst`. The instruction is not counted, cf. count().
+  template <bool KeepDebugInfo, bool CacheEnabled, bool Guarded>
+  void simulate(const DecodedInst &inst);
+
+  // Execute and count the instructions of `block`.
+  template <bool CacheEnabled, bool Guarded>
+  void simulate(const BasicBlock &block);
+
+  void count(const DecodedInst &inst);
+
+  template <bool CacheEnabled, bool Guarded> void interpretThreaded();
+
+  // The loop of interpretThreaded(), which only owns trivially destructible
+  // objects, so that it can be run with runGuarded() if `Guarded` is set.
+  // `code` has a slot for every decoded instruction.
+  struct ThreadedInst;
+  template <bool CacheEnabled, bool Guarded>
+  void runThreaded(ThreadedInst *code);
+
+  // Run `engine(context)` with runGuarded() and turn a fault into
+  // InvalidAddress
+  void interpretGuarded(void (*engine)(void *), void *context);
+
+  template <bool CacheEnabled> void interpretJit();
 
   void simulateLibCFunc(libc::Func funcN);
 
+  // Also remembers whether the branch was taken, cf. stepPipeline()
+  void predictBranch(std::uint32_t branchPc, bool taken) {
+    branchTaken = taken;
+    if (branchPredictor)
+      instCnt.brMiss += branchPredictor->branch(branchPc, taken);
+  }
+
+  void predictJump(std::uint32_t jumpPc, std::uint32_t target) {
+    if (branchPredictor)
+      instCnt.brMiss += branchPredictor->jump(jumpPc, target);
+  }
+
+  // Feed `inst`, which has just been executed, to the pipeline model
+  void stepPipeline(const DecodedInst &inst) {
+    if (pipeline)
+      pipeline->step(inst, branchTaken, cache.getHitMiss().second,
+                     instCnt.brMiss);
+  }
+
+  // Record the instruction at `pc`, which is about to be executed
+  void traceBefore(const DecodedInst &inst) {
+    tracer->begin(pc);
+    if (inst::Instruction::LB <= inst.op && inst.op <= inst::Instruction::SW)
+      tracer->memAccess(regs[inst.rs1] + inst.imm);
+  }
+
+  // Record the register written by `inst`, which has just been executed
+  void traceAfter(const DecodedInst &inst) {
+    using Op = inst::Instruction::OpType;
+    auto op = (Op)inst.op;
+    if (inst.rd != 0 && !(Op::BEQ <= op && op <= Op::BGEU) &&
+        !(Op::SB <= op && op <= Op::SW))
+      tracer->regWrite(inst.rd, regs[inst.rd]);
+  }
+
+  // Tell the profiler the control is at `pc`
+  void profile() {
+    if (profiler && profiler->isEntering(pc))
+      profiler->enter(pc, getProfilerCounters());
+  }
+
+  // Tell the profiler about `inst` if it is a call or a return. `pc` must be
+  // the address of the next instruction.
+  void traceCall(const DecodedInst &inst) {
+    if (!profiler || !profiler->hasCallGraph())
+      return;
+    if (inst.op == inst::Instruction::JAL ||
+        inst.op == inst::Instruction::JALR) {
+      if (inst.rd == 1)
+        profiler->call(pc, getProfilerCounters());
+      else if (inst.rd == 0 && inst.rs1 == 1 && inst.imm == 0) // ret
+        profiler->ret(getProfilerCounters());
+    }
+  }
+
+  Profiler::Counters getProfilerCounters() const;
+
+  // whether the basic interpreter must be used, cf. enablePipelineModel(),
+  // enableProfiler(), enableAnnotation() and enableTrace()
+  bool needsBasicEngine() const {
+    return pipeline || profiler || annotator || tracer;
+  }
+
+  // Copy the counters of the caches into `instCnt`
+  void countCacheAccesses();
+
+  // the # of hits in each level below L1
+  static std::vector<std::size_t> getLowerCacheHits(const Cache &cache);
+
+  static std::size_t computeTime(const InstCnt &instCnt,
+                                 const InstWeight &instWeight,
+                                 const Cache &cache);
+
 private:
   const Interpretable &interpretable;
+  std::vector<DecodedInst> decodedInsts;
+  std::optional<BasicBlockCache> blockCache;
 
   std::optional<std::uint32_t *> externalRegs;
   std::array<std::uint32_t, 32> regs = {0};
   std::int32_t pc = 0;
   Cache cache;
-  std::size_t heapPtr = 0;
-  std::unordered_set<std::size_t> malloced;
-  std::unordered_set<std::size_t> invalidAddress;
+  // the copy of `cache` simulating the accesses if `decoupledTiming`
+  std::unique_ptr<Cache> timingCache;
+  std::optional<InstCache> icache;
+  std::optional<MissRatioCurve> missRatioCurve;
+  std::optional<BranchPredictorConfig> branchPredictorConfig;
+  std::optional<BranchPredictor> branchPredictor;
+  std::optional<PipelineModel> pipeline;
+  std::optional<Profiler> profiler;
+  std::optional<Annotator> annotator;
+  std::optional<InstTraceWriter> tracer;
+  // the cost models added and their caches, which follow `cache`
+  std::vector<std::pair<CostModel, std::unique_ptr<Cache>>> costModels;
+  HeapAllocator heap;
+  // the red zones and freed blocks, checked if `keepDebugInfo`
+  ShadowMemory shadow;
 
   FILE *in;
   FILE *out;
@@ -101,6 +384,13 @@ private:
   InstCnt instCnt;
   bool printInstructions = false;
   bool keepDebugInfo = false;
+  bool threadedDispatch = false;
+  bool jit = false;
+  bool guardPages = false;
+  bool decoupledTiming = false;
+  bool annotate = false;
+  // the outcome of the last conditional branch, cf. predictBranch()
+  bool branchTaken = false;
   std::size_t timeout = (std::size_t)-1;
 };
 
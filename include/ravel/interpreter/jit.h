@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "block_cache.h"
+#include "cache.h"
+
+namespace ravel {
+
+// Translates basic blocks into x86-64 machine code. Only available if ravel
+// is built with RAVEL_JIT (cf. src/CMakeLists.txt). Otherwise `compile()`
+// always fails and the caller keeps interpreting.
+//
+// A translated block executes its instructions on the guest registers and
+// memory in `JitContext` and returns the address of the next instruction. It
+// ticks the cache and accesses it in exactly the same way as
+// `Interpreter::simulate(const BasicBlock &)` except for the ticks after the
+// last memory access, cf. `JitBlock::tailTicks`. Counting the instructions,
+// checking the timeout and calling libc functions are left to the caller.
+//
+// The code is never writable and executable at once: a chunk is mapped
+// writable, and the range of each block is made executable once the block has
+// been copied into it. If the host refuses this, e.g. because it forbids
+// executable memory, a message is printed once and the compiler is disabled.
+class JitCompiler {
+public:
+  struct Context {
+    std::uint32_t *regs = nullptr;
+    std::byte *memory = nullptr;
+    Cache *cache = nullptr;
+    // set if a memory access is out of bounds, in which case the block
+    // returns right before the access
+    bool fault = false;
+    std::size_t faultAddr = 0;
+  };
+
+  using BlockFunc = std::uint32_t (*)(Context *);
+
+  struct JitBlock {
+    BlockFunc func = nullptr;
+    // the number of cache ticks left to the caller
+    std::size_t tailTicks = 0;
+  };
+
+  // `cacheEnabled` must agree with `Cache::isEnabled()` of the caches the
+  // translated blocks are run with.
+  explicit JitCompiler(bool cacheEnabled) : cacheEnabled(cacheEnabled) {}
+  JitCompiler(const JitCompiler &) = delete;
+  JitCompiler &operator=(const JitCompiler &) = delete;
+  ~JitCompiler();
+
+  static bool isSupported();
+
+  // Return a block whose `func` is nullptr if `block` can not be translated.
+  JitBlock compile(const BasicBlock &block);
+
+  // Whether the host refused the memory for the code. The blocks translated
+  // before may not be executable any more, cf. compile().
+  bool isDisabled() const { return disabled; }
+
+private:
+  std::byte *allocate(std::size_t size);
+
+  // Make the pages of [begin, begin + size) writable, or executable if not
+  // `writable`
+  bool protect(std::byte *begin, std::size_t size, bool writable);
+
+  // Print why the JIT gives up and stop translating
+  void disable(const char *call);
+
+private:
+  static constexpr std::size_t ChunkSize = 1024 * 1024;
+
+  bool cacheEnabled;
+  bool disabled = false;
+
+  // the memory for the code, as (begin, size)
+  std::vector<std::pair<std::byte *, std::size_t>> chunks;
+  std::size_t chunkUsed = 0;
+};
+
+} // namespace ravel
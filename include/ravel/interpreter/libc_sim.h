@@ -9,9 +9,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
-#include <unordered_set>
 #include <vector>
 
+#include "heap_allocator.h"
+#include "shadow_memory.h"
+
 // IO
 namespace ravel::libc {
 
@@ -35,13 +37,11 @@ void putchar(std::array<std::uint32_t, 32> &regs, FILE *fp);
 namespace ravel::libc {
 
 void malloc(std::array<std::uint32_t, 32> &regs, std::byte *storage,
-            std::byte *storageEnd, std::size_t &heapPtr,
-            std::unordered_set<std::size_t> &malloced,
-            std::unordered_set<std::size_t> &invalidAddress,
+            std::byte *storageEnd, HeapAllocator &heap, ShadowMemory &shadow,
             std::size_t &instCnt, bool zeroInit = false);
 
-void free(const std::array<std::uint32_t, 32> &regs,
-          std::unordered_set<std::size_t> &malloced);
+void free(const std::array<std::uint32_t, 32> &regs, HeapAllocator &heap,
+          ShadowMemory &shadow);
 
 void memcpy(std::array<std::uint32_t, 32> &regs, std::byte *storage,
             std::byte *storageEnd, std::size_t &instCnt);
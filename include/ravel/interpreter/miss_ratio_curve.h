@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ravel {
+
+// The hits of fully associative LRU caches of every size up to a bound,
+// computed in a single pass over the accesses (Mattson's stack algorithm).
+//
+// The stack distance of an access is the number of distinct lines accessed
+// since the previous access to the same line, and the access hits in every
+// LRU cache with more lines than that. The distance is computed with a
+// Fenwick tree over the time of the accesses, in which only the last access
+// to each line is marked, so an access takes O(log n) time.
+class MissRatioCurve {
+public:
+  MissRatioCurve(std::size_t lineSize, std::size_t maxLines);
+
+  void access(std::size_t addr);
+
+  // The # of hits of a cache with l lines, for each l in [0, maxLines], in
+  // a single pass over the histogram
+  std::vector<std::size_t> getHits() const;
+
+  std::size_t getAccesses() const { return accesses; }
+
+  std::size_t getLineSize() const { return lineSize; }
+
+  std::size_t getMaxLines() const { return histogram.size(); }
+
+private:
+  void mark(std::size_t time, std::int32_t delta);
+
+  // the # of marks in [0, time)
+  std::size_t countBefore(std::size_t time) const;
+
+  // Renumber the last accesses 0, 1, ..., so that the tree does not grow
+  // with the number of accesses
+  void compact();
+
+private:
+  std::size_t lineSize;
+  std::size_t lineSizePow = 0;
+  // histogram[d] is the # of accesses with stack distance d
+  std::vector<std::size_t> histogram;
+  // line -> the time of its last access
+  std::unordered_map<std::size_t, std::size_t> lastAccess;
+  std::vector<std::int32_t> tree;
+  std::size_t now = 0;
+  std::size_t accesses = 0;
+};
+
+} // namespace ravel
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "decoder.h"
+
+namespace ravel {
+
+struct PipelineConfig {
+  PipelineConfig() = default;
+
+  // The latencies of the pipelined multiplier and of the divider, which is
+  // not pipelined
+  std::size_t mulLatency = 3;
+  std::size_t divLatency = 20;
+  // The bubbles after a redirected branch or JALR (resolved in EX) and after
+  // a JAL (resolved in ID)
+  std::size_t branchPenalty = 2;
+  std::size_t jumpPenalty = 1;
+  // The stall of the MEM stage for an access which misses in the cache
+  std::size_t memPenalty = 20;
+  // Whether branches are predicted by the branch predictor (cf.
+  // BranchPredictor) rather than statically as not taken
+  bool predicted = false;
+};
+
+// A cycle-approximate model of a classic 5-stage in-order pipeline
+// (IF/ID/EX/MEM/WB) with full forwarding, fed with the executed instructions
+// in order. It is independent of InstCnt and the weights.
+//
+// Only the time at which each instruction enters EX is tracked. An
+// instruction enters EX one cycle after its predecessor unless
+//   - one of its operands is not ready yet: the result of a load is
+//     forwarded from MEM, so a use right after it stalls for one cycle, and
+//     that of a mul/div becomes ready after its latency (data stall),
+//   - it is a div and the divider is still busy (structural stall),
+//   - the predecessor redirected the control flow (control stall), or
+//   - the predecessor missed in the cache in MEM (memory stall).
+// libc functions are not modelled.
+class PipelineModel {
+public:
+  struct Stats {
+    std::size_t insts = 0;
+    std::size_t cycles = 0;
+    std::size_t loadUse = 0;
+    std::size_t mulDiv = 0;
+    std::size_t structural = 0;
+    std::size_t control = 0;
+    std::size_t memory = 0;
+  };
+
+  explicit PipelineModel(const PipelineConfig &config) : config(config) {}
+
+  // Feed the next instruction. `taken` tells whether it is a taken branch,
+  // even one to the next instruction, and is ignored for anything else.
+  // `memMisses` and `mispredictions` are the running totals of the accesses
+  // which missed in the cache and of the mispredictions.
+  void step(const DecodedInst &inst, bool taken, std::size_t memMisses,
+            std::size_t mispredictions);
+
+  const Stats &getStats() const { return stats; }
+
+private:
+  enum class Producer : std::uint8_t { Alu, Load, MulDiv };
+
+  PipelineConfig config;
+  Stats stats;
+  // the cycle in which the next instruction may enter EX
+  std::size_t nextIssue = 2;
+  std::size_t divBusyUntil = 0;
+  // the cycle from which a register can be forwarded to EX, and what
+  // produced it
+  std::array<std::size_t, 32> ready{};
+  std::array<Producer, 32> producer{};
+  std::size_t lastMemMisses = 0;
+  std::size_t lastMispredictions = 0;
+};
+
+} // namespace ravel
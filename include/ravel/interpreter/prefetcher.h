@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ravel {
+
+enum class PrefetcherKind {
+  // prefetch the lines following the one accessed
+  NextLine,
+  // detect constant strides between the accesses to the same region, and
+  // prefetch along them
+  Stride,
+};
+
+struct PrefetcherConfig {
+  PrefetcherConfig() = default;
+
+  PrefetcherKind kind = PrefetcherKind::NextLine;
+  // the # of lines (or strides) prefetched ahead
+  std::size_t degree = 1;
+  // the # of entries of the (direct mapped) stride table, which must be a
+  // power of two
+  std::size_t tableEntries = 64;
+  // The stride table tracks one stream per region of this size, which must be
+  // a power of two. There is no pc to tell the streams apart.
+  std::size_t regionSize = 4096;
+};
+
+// Decides which lines to prefetch into L1 on each demand access, cf.
+// Cache::setPrefetcher(). Prefetches take effect at once, and only change the
+// contents of the cache.
+class Prefetcher {
+public:
+  Prefetcher(const PrefetcherConfig &config, std::size_t lineSize);
+
+  // Observe a demand access to `addr`, and return the addresses to prefetch.
+  // The result is valid until the next call.
+  const std::vector<std::size_t> &access(std::size_t addr);
+
+private:
+  void trainStride(std::size_t addr);
+
+private:
+  PrefetcherConfig config;
+  std::size_t lineSize;
+  struct Entry {
+    std::size_t region = 0;
+    std::size_t lastAddr = 0;
+    std::int64_t stride = 0;
+    // saturates at 3, and prefetches are issued from 2 on
+    std::uint8_t confidence = 0;
+    bool valid = false;
+  };
+  std::vector<Entry> table;
+  std::vector<std::size_t> targets;
+};
+
+} // namespace ravel
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ravel/linker/interpretable.h"
+
+namespace ravel {
+
+// Attributes the costs of a run to the functions of the program, cf.
+// Interpreter::enableProfiler(). A function spans from its symbol to the next
+// one, where the symbols starting with '.' (the local labels emitted by
+// compilers) and those not in the text are ignored. Each C library function
+// is a function of its own, and the code before the first function is
+// attributed to `_start`.
+//
+// The costs are attributed as the differences of the running totals whenever
+// the control enters another function, so that the interpreter only has to
+// look up the function of each basic block.
+//
+// If the call graph is enabled, the costs are attributed to the call paths as
+// well. The calls and returns are told by the interpreter, and the call paths
+// form a tree, whose root is `_start`.
+class Profiler {
+public:
+  // the running totals of the counters of InstCnt
+  struct Counters {
+    std::size_t simple = 0;
+    std::size_t mul = 0;
+    std::size_t cache = 0;
+    std::size_t br = 0;
+    std::size_t div = 0;
+    std::size_t mem = 0;
+    std::size_t libcIO = 0;
+    std::size_t libcMem = 0;
+    std::size_t icache = 0;
+    std::size_t imem = 0;
+    std::size_t brMiss = 0;
+    // the latency of the hits in the levels below L1, cf.
+    // CacheConfig::latency
+    std::size_t lowerCacheTime = 0;
+
+    // Add `now - before` to the counters
+    void addDifference(const Counters &now, const Counters &before);
+  };
+
+  struct Function {
+    std::string name;
+    std::uint32_t entry = 0;
+    Counters counters;
+  };
+
+  // A node of the call graph
+  struct CallPath {
+    std::size_t func = 0; // the index in getFunctions()
+    std::size_t parent = 0;
+    std::size_t calls = 0;
+    // the costs of the function itself on this path
+    Counters counters;
+  };
+
+  // the costs of the functions on each call path, cf. getCallGraphSummary()
+  struct CallGraphEntry {
+    std::size_t inclusive = 0;
+    std::size_t exclusive = 0;
+    std::size_t calls = 0;
+  };
+
+  // the weighted time of some costs, cf. Interpreter::getTimeConsumed()
+  using TimeFunc = std::function<std::size_t(const Counters &)>;
+
+  explicit Profiler(const Interpretable &interpretable);
+
+  void enableCallGraph();
+
+  bool hasCallGraph() const { return !callPaths.empty(); }
+
+  // Whether `pc` is in another function than the current one
+  bool isEntering(std::uint32_t pc) const {
+    return getFunction(pc) != current;
+  }
+
+  // Attribute the costs since the last call to the current function, and
+  // make the function containing `pc` current
+  void enter(std::uint32_t pc, const Counters &totals);
+
+  // Attribute the remaining costs to the current function
+  void finish(const Counters &totals);
+
+  // Record a call to `target` or a return. Only meaningful if the call graph
+  // is enabled.
+  void call(std::uint32_t target, const Counters &totals);
+  void ret(const Counters &totals);
+
+  const std::vector<Function> &getFunctions() const { return functions; }
+
+  const std::vector<CallPath> &getCallPaths() const { return callPaths; }
+
+  // Return the costs of each function, indexed as getFunctions(), where the
+  // inclusive time of a recursive function counts the outermost calls only
+  std::vector<CallGraphEntry> getCallGraphSummary(const TimeFunc &time) const;
+
+  // Write the exclusive time of each call path in the folded format of
+  // flame graphs, e.g. "_start;main;foo 42"
+  void printFoldedStacks(std::ostream &os, const TimeFunc &time) const;
+
+private:
+  std::size_t getFunction(std::uint32_t pc) const {
+    if (pc < Interpretable::LibcFuncEnd)
+      return libcFuncs[pc];
+    auto slot = pc / 4;
+    return slot < slot2Func.size() ? slot2Func[slot] : 0;
+  }
+
+  // Attribute the costs since the last call to the current function and call
+  // path
+  void flush(const Counters &totals);
+
+  // Visit the call paths depth first, calling `enter` and `leave` with their
+  // indices
+  void walkCallPaths(const std::function<void(std::size_t)> &enter,
+                     const std::function<void(std::size_t)> &leave) const;
+
+private:
+  std::vector<Function> functions;
+  // the index of the function of each pc below Interpretable::LibcFuncEnd
+  std::vector<std::size_t> libcFuncs;
+  // the index of the function of each instruction slot
+  std::vector<std::size_t> slot2Func;
+
+  std::size_t current = 0;
+  Counters last;
+
+  // the tree of call paths, parents first, if the call graph is enabled
+  std::vector<CallPath> callPaths;
+  // (the parent << 32 | the function) -> the index of a call path
+  std::unordered_map<std::uint64_t, std::size_t> children;
+  std::size_t currentPath = 0;
+};
+
+} // namespace ravel
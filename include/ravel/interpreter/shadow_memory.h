@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ravel {
+
+// One bit per byte of the storage telling whether accessing the byte is
+// invalid (e.g. the red zone after a malloc-ed block, or a freed block).
+// Only the prefix of the storage which has ever been poisoned is covered, so
+// the bitmap grows with the heap rather than with the storage.
+class ShadowMemory {
+public:
+  // Mark [begin, end) invalid
+  void poison(std::size_t begin, std::size_t end);
+
+  // Mark [begin, end) valid
+  void unpoison(std::size_t begin, std::size_t end);
+
+  bool isPoisoned(std::size_t addr) const {
+    auto word = addr / 64;
+    return word < bits.size() && (bits[word] >> (addr % 64) & 1u);
+  }
+
+private:
+  std::vector<std::uint64_t> bits;
+};
+
+} // namespace ravel
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace ravel {
+
+// A memory access forwarded to the timing model, cf. Cache::forwardTo()
+struct TraceEvent {
+  std::uint64_t cycles = 0;
+  std::uint32_t addr = 0;
+};
+
+// A lock-free single-producer/single-consumer ring of trace events, which
+// lets the functional simulation run ahead of the timing model on another
+// thread.
+//
+// The producer publishes its events in batches, so the consumer only sees
+// them once a batch is full or the ring is closed.
+class TraceRing {
+public:
+  TraceRing() : buffer(Capacity) {}
+
+  // Called by the producer. Waits while the ring is full.
+  void push(const TraceEvent &event) {
+    if (localHead - cachedTail == Capacity)
+      waitForSpace();
+    buffer[localHead & Mask] = event;
+    if ((++localHead & (Batch - 1)) == 0)
+      head.store(localHead, std::memory_order_release);
+  }
+
+  // Called by the producer after the last event
+  void close() {
+    head.store(localHead, std::memory_order_release);
+    closed.store(true, std::memory_order_release);
+  }
+
+  // Called by the consumer. Pass every event to `func` until the ring is
+  // closed and empty.
+  template <class Func> void consume(Func &&func) {
+    std::size_t tail = 0;
+    while (true) {
+      bool isClosed = closed.load(std::memory_order_acquire);
+      auto end = head.load(std::memory_order_acquire);
+      if (tail == end) {
+        if (isClosed)
+          return;
+        std::this_thread::yield();
+        continue;
+      }
+      for (; tail != end; ++tail)
+        func(buffer[tail & Mask]);
+      this->tail.store(tail, std::memory_order_release);
+    }
+  }
+
+private:
+  void waitForSpace() {
+    // the consumer may be waiting for the current batch
+    head.store(localHead, std::memory_order_release);
+    while (localHead - (cachedTail = tail.load(std::memory_order_acquire)) ==
+           Capacity)
+      std::this_thread::yield();
+  }
+
+private:
+  static constexpr std::size_t Capacity = 1u << 16u;
+  static constexpr std::size_t Mask = Capacity - 1;
+  static constexpr std::size_t Batch = 256;
+
+  std::vector<TraceEvent> buffer;
+  // written by the producer
+  alignas(64) std::atomic<std::size_t> head{0};
+  std::atomic<bool> closed{false};
+  // written by the consumer
+  alignas(64) std::atomic<std::size_t> tail{0};
+  // only used by the producer
+  alignas(64) std::size_t localHead = 0;
+  std::size_t cachedTail = 0;
+};
+
+} // namespace ravel
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cassert>
 #include <cstddef>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "ravel/instructions.h"
@@ -28,18 +30,35 @@ public:
   static constexpr std::size_t LibcFuncStart = 12;
   static constexpr std::size_t LibcFuncEnd = 48;
 
-  Interpretable(std::vector<std::byte> storage,
-                std::vector<std::shared_ptr<inst::Instruction>> insts)
-      : storage(std::move(storage)), insts(std::move(insts)) {}
+  Interpretable(
+      std::vector<std::byte> storage,
+      std::vector<std::shared_ptr<inst::Instruction>> insts,
+      std::vector<std::size_t> instPositions,
+      std::vector<std::pair<std::string, std::size_t>> symbols = {})
+      : storage(std::move(storage)), insts(std::move(insts)),
+        instPositions(std::move(instPositions)), symbols(std::move(symbols)) {
+    assert(this->insts.size() == this->instPositions.size());
+  }
 
   const std::vector<std::byte> &getStorage() const { return storage; }
   const std::vector<std::shared_ptr<inst::Instruction>> &getInsts() const {
     return insts;
   }
+  // instPositions[i] is the address at which insts[i] is stored
+  const std::vector<std::size_t> &getInstPositions() const {
+    return instPositions;
+  }
+  // The symbols of all the object files (including local labels) and of the
+  // C library functions, with their addresses, sorted by address
+  const std::vector<std::pair<std::string, std::size_t>> &getSymbols() const {
+    return symbols;
+  }
 
 private:
   std::vector<std::byte> storage;
   std::vector<std::shared_ptr<inst::Instruction>> insts;
+  std::vector<std::size_t> instPositions;
+  std::vector<std::pair<std::string, std::size_t>> symbols;
 };
 
 namespace libc {
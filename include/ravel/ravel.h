@@ -5,14 +5,28 @@
 #include "ravel/assembler/parser.h"
 #include "ravel/assembler/preprocessor.h"
 
+#include "ravel/interpreter/annotator.h"
+#include "ravel/interpreter/block_cache.h"
+#include "ravel/interpreter/branch_predictor.h"
 #include "ravel/interpreter/cache.h"
+#include "ravel/interpreter/decoder.h"
+#include "ravel/interpreter/heap_allocator.h"
+#include "ravel/interpreter/inst_trace.h"
 #include "ravel/interpreter/interpreter.h"
+#include "ravel/interpreter/jit.h"
 #include "ravel/interpreter/libc_sim.h"
+#include "ravel/interpreter/miss_ratio_curve.h"
+#include "ravel/interpreter/pipeline.h"
+#include "ravel/interpreter/prefetcher.h"
+#include "ravel/interpreter/profiler.h"
+#include "ravel/interpreter/shadow_memory.h"
+#include "ravel/interpreter/trace_ring.h"
 
 #include "ravel/linker/interpretable.h"
 #include "ravel/linker/linker.h"
 
 #include "ravel/container_utils.h"
 #include "ravel/error.h"
+#include "ravel/guest_memory.h"
 #include "ravel/instructions.h"
 #include "ravel/simulator.h"
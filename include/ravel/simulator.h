@@ -2,31 +2,84 @@
 
 #include <array>
 #include <cstdio>
+#include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <variant>
 #include <vector>
 
 #include "ravel/assembler/assembler.h"
+#include "ravel/guest_memory.h"
 #include "ravel/interpreter/interpreter.h"
 #include "ravel/linker/linker.h"
 
 namespace ravel {
 
+// the format of the statistics printed after a run, cf. SimulationResult
+enum class StatsFormat { Text, Json, Csv };
+
 struct Config {
   Config() = default;
 
   bool printInsts = false;
+  StatsFormat statsFormat = StatsFormat::Text;
   bool cacheEnabled = false;
+  // L1 first
+  std::vector<CacheConfig> cacheLevels = {CacheConfig()};
+  InclusionPolicy cacheInclusion = InclusionPolicy::Inclusive;
+  // prefetch into L1, cf. Prefetcher
+  std::optional<PrefetcherConfig> prefetcher;
+  // model instruction fetches with an I-cache, cf. InstCache
+  std::optional<CacheConfig> instCache;
+  // predict branches and charge mispredictions, cf. BranchPredictor
+  std::optional<BranchPredictorConfig> branchPredictor;
+  // if not empty, write the statistics of every branch to this file
+  std::string branchStatsFile;
+  // run a pipeline model alongside, cf. PipelineModel
+  std::optional<PipelineConfig> pipeline;
+  // print the costs of each function, cf. Profiler
+  bool profile = false;
+  // if not empty, write the costs of each function to this file as well
+  std::string profileFile;
+  // if not empty, print the costs of the call graph, and write the folded
+  // stacks to this file, cf. Profiler::printFoldedStacks()
+  std::string callGraphFile;
+  // print the assembly annotated with the execution counts, to this file if
+  // not empty, cf. Annotator
+  bool annotate = false;
+  std::string annotateFile;
+  // if not empty, write the executed instructions to this file, cf.
+  // InstTraceWriter
+  std::string traceFile;
+  bool traceCompress = false;
+  // If not 0, print the miss ratio curve for caches of up to this many lines
+  // of L1's size, cf. MissRatioCurve
+  std::size_t missRatioCurve = 0;
   bool keepDebugInfo = false;
+  // use the threaded interpreter, cf. Interpreter::enableThreadedDispatch()
+  bool threadedDispatch = false;
+  // translate hot code into host machine code, cf. Interpreter::enableJit()
+  bool jit = false;
+  // simulate the cache on another thread, cf.
+  // Interpreter::enableDecoupledTiming()
+  bool decoupledTiming = false;
   std::string inputFile;
   std::string outputFile;
   std::vector<std::string> sources;
   InstWeight instWeight = InstWeight();
+  // further cost models evaluated in the same run, cf.
+  // Interpreter::addCostModel()
+  std::vector<CostModel> costModels;
   // exits when # of instructions executed exceeds `timeout`
   std::size_t timeout = (std::size_t)-1;
 
   std::size_t maxStorageSize = 512 * 1024 * 1024;
+  // allocate the storage lazily, cf. GuestMemory
+  bool lazyStorage = true;
+  // surround the storage with guard regions, cf. GuestMemory and
+  // Interpreter::enableGuardPages()
+  bool guardPages = false;
 
   // use external registers and memory
   std::uint32_t *externalRegs = nullptr;
@@ -34,23 +87,69 @@ struct Config {
   std::byte *externalStorageEnd = nullptr;
 };
 
+// The statistics of a run
+struct SimulationResult {
+  std::uint32_t exitCode = 0;
+  bool memoryLeak = false;
+  // cf. Interpreter::getTimeConsumed()
+  std::size_t time = 0;
+  // the time under each cost model of Config::costModels
+  std::vector<std::size_t> costModelTimes;
+  InstCnt instCnt;
+  // the hits and misses of each cache level, L1 first, if the cache is
+  // enabled
+  std::vector<std::pair<std::size_t, std::size_t>> cacheHitMiss;
+  // the prefetches issued and those hit later, cf. Cache::getPrefetches()
+  std::size_t prefetches = 0;
+  std::size_t usefulPrefetches = 0;
+  // cf. Interpreter::getPeakMemory()
+  std::size_t peakMemory = 0;
+  // the wall-clock times of assembling and linking, and of interpreting, in
+  // ms
+  std::size_t buildTime = 0;
+  std::size_t interpretTime = 0;
+
+  // A statistic, cf. getFields()
+  struct Field {
+    std::string name;
+    std::size_t value = 0;
+    // whether `value` is a boolean, i.e. 0 or 1
+    bool isBool = false;
+  };
+
+  // The statistics in a fixed order
+  std::vector<Field> getFields() const;
+};
+
 class Simulator {
 public:
   explicit Simulator(Config config_);
 
-  std::size_t simulate();
+  SimulationResult simulate();
 
 private:
-  Interpretable buildInterpretable();
+  Interpretable buildInterpretable(SimulationResult &result);
 
   std::pair<FILE *, FILE *> getIOFile() const;
 
-  void printResult(const Interpreter &interpreter) const;
+  SimulationResult getResult(const Interpreter &interpreter) const;
+
+  void printResult(const Interpreter &interpreter,
+                   const SimulationResult &result) const;
+
+  void printStats(const Interpreter &interpreter) const;
+
+  void printStats(const SimulationResult &result) const;
+
+  void printProfile(const Interpreter &interpreter) const;
+
+  void printCallGraph(const Interpreter &interpreter) const;
 
 private:
   Config config;
   std::variant<std::array<std::uint32_t, 32>, std::uint32_t *> regs;
-  std::variant<std::vector<std::byte>, std::pair<std::byte *, std::byte *>>
+  std::variant<std::unique_ptr<GuestMemory>,
+               std::pair<std::byte *, std::byte *>>
       storage;
 };
 
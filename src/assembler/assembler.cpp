@@ -7,6 +7,7 @@
 #include <functional>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
@@ -58,14 +59,15 @@ namespace {
 class AssemblerPass1 {
 public:
   // If `forceSingleFile` is true, then no external symbols are allowed.
-  explicit AssemblerPass1(std::vector<std::string> src) : src(std::move(src)) {}
+  explicit AssemblerPass1(const std::vector<std::string_view> &src)
+      : src(src) {}
 
   std::tuple<std::vector<std::byte> /* storage */,
              std::unordered_map<std::string, std::size_t> /* labelName2Pos */,
              std::unordered_set<std::string> /* globalSymbols */,
              std::vector<std::pair<std::string, std::size_t>> /* toBeStored */>
   operator()() {
-    for (auto &line : src) {
+    for (auto line : src) {
       if (isDirective(line)) {
         handleDerivative(line);
         continue;
@@ -112,7 +114,8 @@ public:
       labelName2Pos.emplace(labelName, pos);
     }
 
-    return {storage, labelName2Pos, globalSymbols, toBeStored};
+    return {std::move(storage), std::move(labelName2Pos),
+            std::move(globalSymbols), std::move(toBeStored)};
   }
 
 private:
@@ -131,8 +134,8 @@ private:
     }
   }
 
-  void handleDerivative(const std::string &line) {
-    auto tokens = tokenize(line);
+  void handleDerivative(std::string_view line) {
+    tokenize(line, tokens);
     assert(!tokens.empty());
 
     if (tokens[0] == ".text") {
@@ -174,7 +177,7 @@ private:
     auto &storage = getCurSecStorage();
 
     if (tokens[0] == ".align" || tokens[0] == ".p2align") {
-      auto p = std::stoul(tokens.at(1));
+      auto p = std::stoul(std::string(tokens.at(1)));
       auto alignment = 1u << p;
       storage.resize(roundUp(storage.size(), alignment));
       return;
@@ -185,8 +188,8 @@ private:
     }
     if (tokens[0] == ".comm") {
       auto label = tokens.at(1);
-      std::size_t size = std::stoul(tokens.at(2));
-      std::size_t alignment = std::stoul(tokens.at(3));
+      std::size_t size = std::stoul(std::string(tokens.at(2)));
+      std::size_t alignment = std::stoul(std::string(tokens.at(3)));
       bss.resize(roundUp(bss.size(), alignment));
       auto pos = bss.size();
       bss.resize(bss.size() + size);
@@ -194,7 +197,7 @@ private:
       return;
     }
     if (tokens[0] == ".zero") {
-      std::size_t size = std::stoul(tokens.at(1));
+      std::size_t size = std::stoul(std::string(tokens.at(1)));
       storage.resize(storage.size() + size, (std::byte)0);
       return;
     }
@@ -207,8 +210,8 @@ private:
         ++iter;
       assert(*iter == '"');
       ++iter;
-      std::string str(iter, line.end() - 1);
-      str = handleEscapeCharacters(str);
+      auto str = handleEscapeCharacters(
+          line.substr(iter - line.begin(), line.end() - 1 - iter));
       auto curPos = storage.size();
       storage.resize(storage.size() + str.size() + 1);
       std::strcpy((char *)(storage.data() + curPos), str.c_str());
@@ -226,7 +229,7 @@ private:
         toBeStored.emplace_back(tokens.at(1), curPos);
         return;
       }
-      std::int32_t val = std::stoi(tokens.at(1), nullptr, 0);
+      std::int32_t val = std::stoi(std::string(tokens.at(1)), nullptr, 0);
       *(std::int32_t *)(storage.data() + curPos) = val;
       return;
     }
@@ -234,9 +237,9 @@ private:
     std::cerr << "Ignoring directive: " << line << std::endl;
   }
 
-  void handleLabel(std::string label) {
-    assert(tokenize(label).size() == 1);
-    label.pop_back(); // remove ':'
+  void handleLabel(std::string_view line) {
+    assert(line.find_first_of(" ,\t") == std::string_view::npos);
+    std::string label(line.substr(0, line.size() - 1)); // remove ':'
     if (isIn(labelName2SecPos, label)) {
       throw DuplicatedSymbols(label);
     }
@@ -245,8 +248,10 @@ private:
   }
 
 private:
-  const std::vector<std::string> src;
+  const std::vector<std::string_view> &src;
   Section curSection = Section::ERROR;
+  // the tokens of the current line
+  std::vector<std::string_view> tokens;
 
   std::vector<std::byte> text, data, rodata, bss;
   // cf. ObjectFile
@@ -258,14 +263,15 @@ private:
 class AssemblerPass2 {
 public:
   AssemblerPass2(
-      const std::vector<std::string> &src, std::vector<std::byte> &storage,
+      const std::vector<std::string_view> &src, std::vector<std::byte> &storage,
       const std::unordered_map<std::string, std::size_t> &labelName2Pos)
       : src(src), storage(storage), labelName2Pos(labelName2Pos) {}
 
   auto operator()() {
     bool isText = false;
-    for (auto &line : src) {
-      auto tokens = tokenize(line);
+    std::vector<std::string_view> tokens;
+    for (auto line : src) {
+      tokenize(line, tokens);
 
       if (line == ".text") {
         isText = true;
@@ -282,20 +288,21 @@ public:
       }
       if (!isText)
         continue;
-      parseCurrentLine(line);
+      parseCurrentLine(line, tokens);
     }
 
-    return std::make_tuple(insts, inst2Pos, containsExternalLabel,
-                           containsRelocationFunc);
+    return std::make_tuple(std::move(insts), std::move(inst2Pos),
+                           std::move(containsExternalLabel),
+                           std::move(containsRelocationFunc));
   }
 
 private:
-  void parseCurrentLine(const std::string &line) {
-    auto tokens = tokenize(line);
+  void parseCurrentLine(std::string_view line,
+                        const std::vector<std::string_view> &tokens) {
     if (isDirective(line)) {
       if (tokens.at(0) != ".align" && tokens.at(0) != ".p2align")
         return;
-      auto alignment = std::stoul(tokens.at(1));
+      auto alignment = std::stoul(std::string(tokens.at(1)));
       curPos = roundUp(curPos, 1u << alignment);
       return;
     }
@@ -304,35 +311,35 @@ private:
       return;
     }
     try {
-      handleInst(line);
+      handleInst(line, tokens);
     } catch (NotSupportedError &e) {
-      throw NotSupportedError(std::string(e.what()) + " Line: " + line);
+      throw NotSupportedError(concat({e.what(), " Line: ", line}));
     }
   }
 
   // If [str] is a number, then return it.
   // If [str] is a non-external label, then compute the offset if possible
-  std::optional<int> getOffset(std::string str) const {
+  std::optional<int> getOffset(std::string_view str) const {
     if (std::isdigit(str.front()) && std::isdigit(str.back())) {
-      return std::stoi(str, nullptr, 0);
+      return std::stoi(std::string(str), nullptr, 0);
     }
     // is a label
     if (std::isdigit(str.front())) {
       throw NotSupportedError("local label has not been supported yet");
     }
-    auto pos = get(labelName2Pos, str);
+    auto pos = get(labelName2Pos, std::string(str));
     if (!pos)
       return std::nullopt;
     return (std::int64_t)pos.value() - (std::int64_t)curPos;
   }
 
-  void handleInst(const std::string &line) {
-    auto tokens = tokenize(line);
+  void handleInst(std::string_view line,
+                  const std::vector<std::string_view> &tokens) {
     std::shared_ptr<inst::Instruction> inst;
     try {
       inst = parseInst(tokens);
     } catch (Exception &e) {
-      e.setMsg("When parsing \"" + line + "\", get: " + e.what());
+      e.setMsg(concat({"When parsing \"", line, "\", get: ", e.what()}));
       throw ;
     }
     assert(curPos + 3 < storage.size());
@@ -343,14 +350,14 @@ private:
   }
 
   std::shared_ptr<inst::Instruction>
-  parseInst(const std::vector<std::string> &tokens) {
+  parseInst(const std::vector<std::string_view> &tokens) {
     assert(!tokens.empty());
 
     inst::Instruction::OpType op;
     try {
       op = name2OpType(tokens[0]);
     } catch (std::out_of_range &e) {
-      throw NotSupportedError("Unknown op: " + tokens[0]);
+      throw NotSupportedError(concat({"Unknown op: ", tokens[0]}));
     }
 
     if (op == inst::Instruction::LUI || op == inst::Instruction::AUIPC) {
@@ -366,7 +373,7 @@ private:
                                                      parseImm(immStr));
     }
 
-    static std::unordered_set<std::string> arithRegReg = {
+    static std::unordered_set<std::string_view> arithRegReg = {
         "add", "sub", "sll", "slt", "sltu", "xor", "srl", "sra", "or", "and"};
     if (isIn(arithRegReg, tokens[0])) {
       auto dest = regName2regNumber(tokens.at(1));
@@ -375,7 +382,7 @@ private:
       return std::make_shared<inst::ArithRegReg>(op, dest, src1, src2);
     }
 
-    static std::unordered_set<std::string> arithRegImmInsts = {
+    static std::unordered_set<std::string_view> arithRegImmInsts = {
         "addi", "slti", "sltiu", "xori", "ori", "andi", "slli", "srli", "srai"};
     if (isIn(arithRegImmInsts, tokens.at(0))) {
       auto dest = regName2regNumber(tokens.at(1));
@@ -391,16 +398,17 @@ private:
                                                  parseImm(immStr));
     }
 
-    static std::unordered_set<std::string> memAccessInsts = {
+    static std::unordered_set<std::string_view> memAccessInsts = {
         "lb", "lh", "lw", "lbu", "lhu", "sb", "sh", "sw"};
     if (isIn(memAccessInsts, tokens[0])) {
       auto reg = regName2regNumber(tokens.at(1));
       auto baseOffsetStr = tokens.at(2);
       if (baseOffsetStr.front() == '%') { // e.g. %lo(l)(a5)
-        auto addrTokens = split(baseOffsetStr, "()");
+        auto addrTokens = splitView(baseOffsetStr, "()");
         assert(addrTokens.front() == "%lo" ||
                addrTokens.front() == "%pcrel_lo");
-        auto relocation = addrTokens.at(0) + "(" + addrTokens.at(1) + ")";
+        auto relocation =
+            concat({addrTokens.at(0), "(", addrTokens.at(1), ")"});
         auto base = regName2regNumber(addrTokens.back());
         auto inst = std::make_shared<inst::MemAccess>(op, reg, base, 0);
         containsRelocationFunc.emplace(inst->getId(),
@@ -417,8 +425,9 @@ private:
       auto offsetOpt = getOffset(tokens.at(2));
       if (offsetOpt)
         return std::make_shared<inst::JumpLink>(dest, offsetOpt.value() / 2,
-                                                tokens.at(2));
-      auto inst = std::make_shared<inst::JumpLink>(dest, 0, tokens[2]);
+                                                std::string(tokens.at(2)));
+      auto inst =
+          std::make_shared<inst::JumpLink>(dest, 0, std::string(tokens[2]));
       containsExternalLabel.emplace(inst->getId(), tokens[2]);
       return inst;
     }
@@ -427,10 +436,11 @@ private:
       auto dest = regName2regNumber(tokens.at(1));
       auto baseOffsetStr = tokens.at(2);
       if (baseOffsetStr.front() == '%') { // e.g. %lo(l)(a5)
-        auto addrTokens = split(baseOffsetStr, "()");
+        auto addrTokens = splitView(baseOffsetStr, "()");
         assert(addrTokens.front() == "%lo" ||
                addrTokens.front() == "%pcrel_lo");
-        auto relocation = addrTokens.at(0) + "(" + addrTokens.at(1) + ")";
+        auto relocation =
+            concat({addrTokens.at(0), "(", addrTokens.at(1), ")"});
         auto base = regName2regNumber(addrTokens.back());
         auto inst = std::make_shared<inst::JumpLinkReg>(dest, base, 0);
         containsRelocationFunc.emplace(inst->getId(),
@@ -441,7 +451,7 @@ private:
       return std::make_shared<inst::JumpLinkReg>(dest, base, offset);
     }
 
-    static std::unordered_set<std::string> branchInsts = {
+    static std::unordered_set<std::string_view> branchInsts = {
         "beq", "bne", "blt", "bge", "bltu", "bgeu"};
     if (isIn(branchInsts, tokens[0])) {
       auto src1 = regName2regNumber(tokens.at(1));
@@ -449,14 +459,15 @@ private:
       auto offsetOpt = getOffset(tokens.at(3));
       if (offsetOpt)
         return std::make_shared<inst::Branch>(op, src1, src2, offsetOpt.value(),
-                                              tokens[3]);
+                                              std::string(tokens[3]));
       // external
-      auto inst = std::make_shared<inst::Branch>(op, src1, src2, 0, tokens[3]);
+      auto inst = std::make_shared<inst::Branch>(op, src1, src2, 0,
+                                                 std::string(tokens[3]));
       containsExternalLabel.emplace(inst->getId(), tokens.at(3));
       return inst;
     }
 
-    static std::unordered_set<std::string> mArithInsts = {
+    static std::unordered_set<std::string_view> mArithInsts = {
         "mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu"};
     if (isIn(mArithInsts, tokens[0])) {
       auto dest = regName2regNumber(tokens.at(1));
@@ -468,9 +479,9 @@ private:
     throw NotSupportedError("Unknown instruction");
   }
 
-  static RelocationFunction parseRelocationFunction(const std::string &str) {
+  static RelocationFunction parseRelocationFunction(std::string_view str) {
     assert(str.front() == '%');
-    auto tokens = split(str, "()+");
+    auto tokens = splitView(str, "()+");
     assert(tokens.size() == 2 || tokens.size() == 3);
     auto func = tokens.front();
     auto symbol = tokens[1];
@@ -480,19 +491,20 @@ private:
         offset = parseImm(tokens.back());
       return RelocationFunction(func == "%hi" ? RelocationFunction::HI
                                               : RelocationFunction::LO,
-                                symbol, offset);
+                                std::string(symbol), offset);
     }
     if (func != "%pcrel_hi" && func != "%pcrel_lo") {
-      throw NotSupportedError("Unsupported relocation function: " + func);
+      throw NotSupportedError(
+          concat({"Unsupported relocation function: ", func}));
     }
     return RelocationFunction(func == "%pcrel_hi"
                                   ? RelocationFunction::PCREL_HI
                                   : RelocationFunction::PCREL_LO,
-                              symbol);
+                              std::string(symbol));
   }
 
 private:
-  const std::vector<std::string> &src;
+  const std::vector<std::string_view> &src;
   std::size_t curPos = 0;
 
   std::vector<std::byte> &storage;
@@ -513,19 +525,17 @@ private:
 namespace ravel {
 
 ObjectFile assemble(const std::string &src) {
-  auto lines = preprocess(src);
+  auto source = preprocess(src);
+  const auto &lines = source.statements;
   auto [storage, labelName2Pos, globalSymbols, toBeStored] =
       AssemblerPass1(lines)();
   auto [insts, inst2Pos, containsExternalLabel, containsRelocationFunc] =
       AssemblerPass2(lines, storage, labelName2Pos)();
 
-  std::unordered_map<std::string, std::size_t> symTable;
-  for (auto &[label, pos] : labelName2Pos)
-    symTable.emplace(label, pos);
   return {std::move(storage),
           std::move(insts),
           std::move(inst2Pos),
-          std::move(symTable),
+          std::move(labelName2Pos),
           std::move(globalSymbols),
           std::move(containsExternalLabel),
           std::move(containsRelocationFunc),
@@ -2,56 +2,84 @@
 
 #include <algorithm>
 #include <cctype>
-#include <regex>
-#include <sstream>
+#include <charconv>
 #include <unordered_map>
 
 #include "ravel/container_utils.h"
 #include "ravel/error.h"
 
 namespace ravel {
+namespace {
 
-std::string strip(std::string str) {
-  auto whitespaces = " \t\n\r\f\v";
-  str.erase(str.find_last_not_of(whitespaces) + 1);
-  str.erase(0, str.find_first_not_of(whitespaces));
-  return str;
-}
-
-std::vector<std::string> split(const std::string &s,
-                               const std::string &delimiters) {
-  std::vector<std::string> words;
-
+// Append the words of `s` to `words`
+void appendWords(std::string_view s, std::string_view delimiters,
+                 std::vector<std::string_view> &words) {
   std::size_t next = -1;
   do {
     auto current = next + 1;
     next = s.find_first_of(delimiters, current);
-    if (next > current) // no empty word
+    if (next > current && current < s.size()) // no empty word
       words.emplace_back(s.substr(current, next - current));
-  } while (next != std::string::npos);
+  } while (next != std::string_view::npos);
+}
+
+} // namespace
 
-  // myList.erase(
-  //    std::remove_if(myList.begin(), myList.end(), IsMarkedToDelete),
-  //    myList.end());
-  words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+std::string_view strip(std::string_view str) {
+  auto whitespaces = " \t\n\r\f\v";
+  auto begin = str.find_first_not_of(whitespaces);
+  if (begin == std::string_view::npos)
+    return {};
+  return str.substr(begin, str.find_last_not_of(whitespaces) + 1 - begin);
+}
 
+std::vector<std::string> split(const std::string &s,
+                               const std::string &delimiters) {
+  auto words = splitView(s, delimiters);
+  return {words.begin(), words.end()};
+}
+
+std::vector<std::string_view> splitView(std::string_view s,
+                                        std::string_view delimiters) {
+  std::vector<std::string_view> words;
+  words.reserve(4); // enough for the operands of an instruction
+  appendWords(s, delimiters, words);
   return words;
 }
 
-std::vector<std::string> tokenize(const std::string &line) {
-  auto tokens = split(line, " ,\t");
+std::vector<std::string_view> tokenize(std::string_view line) {
+  std::vector<std::string_view> tokens;
+  tokenize(line, tokens);
+  return tokens;
+}
+
+void tokenize(std::string_view line, std::vector<std::string_view> &tokens) {
+  tokens.clear();
+  appendWords(line, " ,\t", tokens);
   if (tokens.at(0) == ".string") {
     tokens = {".string", strip(line.substr(7))};
   }
-  return tokens;
 }
 
-bool isDirective(const std::string &str) {
-  auto words = split(str);
-  return words.at(0).at(0) == '.' && words.at(0).back() != ':';
+std::string concat(std::initializer_list<std::string_view> parts) {
+  std::size_t size = 0;
+  for (auto part : parts)
+    size += part.size();
+  std::string res;
+  res.reserve(size);
+  for (auto part : parts)
+    res += part;
+  return res;
 }
 
-bool isLabel(const std::string &str) { return str.back() == ':'; }
+bool isDirective(std::string_view str) {
+  // the first word
+  auto begin = str.find_first_not_of(" \t");
+  auto word = str.substr(begin, str.find_first_of(" \t", begin) - begin);
+  return word.at(0) == '.' && word.back() != ':';
+}
+
+bool isLabel(std::string_view str) { return str.back() == ':'; }
 
 std::optional<std::string> getSectionName(const std::string &line) {
   if (line == ".text" || line == ".data" || line == ".rodata" || line == ".bss")
@@ -117,7 +145,7 @@ std::string opType2Name(inst::Instruction::OpType op) {
   return name;
 }
 
-inst::Instruction::OpType name2OpType(std::string name) {
+inst::Instruction::OpType name2OpType(std::string_view name) {
   using namespace std::string_literals;
   static std::unordered_map<std::string, inst::Instruction::OpType> mp{
       {"LUI"s, inst::Instruction::LUI},
@@ -167,19 +195,20 @@ inst::Instruction::OpType name2OpType(std::string name) {
       {"REMU"s, inst::Instruction::REMU},
   };
 
-  for (auto &c : name) {
+  std::string upper(name);
+  for (auto &c : upper) {
     c = toupper((unsigned char)c);
   }
 
-  return mp.at(name);
+  return mp.at(upper);
 }
 
-std::size_t regName2regNumber(const std::string &name) {
+std::size_t regName2regNumber(std::string_view name) {
   if (name.at(0) == 'x') {
     if (name.size() == 1 || !std::isdigit(name.at(1))) {
-      throw Exception("Unknown register: " + name);
+      throw Exception("Unknown register: " + std::string(name));
     }
-    return (std::size_t)std::stoi(name.substr(1));
+    return (std::size_t)std::stoi(std::string(name.substr(1)));
   }
 
   static std::vector<std::string> names = {
@@ -193,21 +222,26 @@ std::size_t regName2regNumber(const std::string &name) {
   }
 
   if (name != "fp")
-    throw Exception("Unknown register: " + name);
+    throw Exception("Unknown register: " + std::string(name));
   return 8;
 }
 
-std::pair<std::size_t, int> parseBaseOffset(const std::string &str) {
-  std::stringstream ss(str);
-  int offset;
-  ss >> offset;
-  auto ch = (char)ss.get();
-  assert(ch == '(');
-  std::string regName;
-  ss >> regName;
-  assert(regName.back() == ')');
-  regName.pop_back();
-  auto reg = regName2regNumber(regName);
+std::pair<std::size_t, int> parseBaseOffset(std::string_view str) {
+  // offset(reg), where the offset may be omitted
+  auto open = str.find('(');
+  if (open == std::string_view::npos || str.back() != ')')
+    throw Exception("Invalid address: " + std::string(str));
+  auto offsetStr = str.substr(0, open);
+  if (!offsetStr.empty() && offsetStr.front() == '+')
+    offsetStr.remove_prefix(1);
+  int offset = 0;
+  if (!offsetStr.empty()) {
+    auto end = offsetStr.data() + offsetStr.size();
+    auto [ptr, ec] = std::from_chars(offsetStr.data(), end, offset);
+    if (ec != std::errc() || ptr != end)
+      throw Exception("Invalid address: " + std::string(str));
+  }
+  auto reg = regName2regNumber(str.substr(open + 1, str.size() - open - 2));
   return {reg, offset};
 }
 
@@ -258,22 +292,22 @@ std::string regNumber2regName(const std::size_t &num) {
   return names.at(num);
 }
 
-std::string parseSectionDerivative(const std::string &line) {
-  auto tokens = split(line, " \t,.");
+std::string parseSectionDerivative(std::string_view line) {
+  auto tokens = splitView(line, " \t,.");
   assert(tokens.at(0) == "section");
   auto name = tokens.at(1);
   if (name.front() == 's') {
     assert(name == "sdata" || name == "srodata" || name == "sbss");
-    name = name.substr(1);
+    name.remove_prefix(1);
   }
-  return "." + name;
+  return concat({".", name});
 }
 
-std::uint32_t parseImm(const std::string &str) {
-  return std::stoul(str, nullptr, 0);
+std::uint32_t parseImm(std::string_view str) {
+  return std::stoul(std::string(str), nullptr, 0);
 }
 
-std::string handleEscapeCharacters(const std::string &str) {
+std::string handleEscapeCharacters(std::string_view str) {
   static std::unordered_map<char, char> escape = {
       {'\'', '\''}, {'\"', '\"'}, {'\\', '\\'}, {'n', '\n'}, {'r', '\r'},
       {'t', '\t'},  {'b', '\b'},  {'f', '\f'},  {'v', '\v'},
@@ -1,9 +1,9 @@
 #include "ravel/assembler/preprocessor.h"
 
+#include <algorithm>
 #include <cassert>
+#include <optional>
 #include <random>
-#include <regex>
-#include <sstream>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -14,195 +14,195 @@
 namespace ravel {
 namespace {
 
-std::vector<std::string> splitIntoLines(const std::string &src) {
-  std::vector<std::string> lines;
+const std::string PseudoInstLabel = "_pseudo_inst_label_";
 
-  std::stringstream ss(src);
-  for (std::string line; std::getline(ss, line, '\n');)
-    lines.push_back(line);
-
-  return lines;
+bool isSpace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v';
 }
 
-std::string removeComments(const std::string &line) {
-  // be careful with the case: .string "#"
-  // remove comments
-  std::size_t pos = std::string::npos;
-  bool inString = false;
-  for (std::size_t i = 0; i < line.size(); ++i) {
-    auto ch = line[i];
-    if (!inString && ch == '#') {
-      pos = i;
-      break;
-    }
-    if (ch == '"') {
-      inString = !inString;
-      continue;
-    }
-    if (inString && ch == '\\') {
-      ++i;
-      continue;
-    }
-  }
-  if (pos == std::string::npos)
-    return line;
-  return line.substr(0, pos);
+bool isLabelChar(char ch) {
+  return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') ||
+         ('0' <= ch && ch <= '9') || ch == '.' || ch == '_';
 }
 
-std::vector<std::string> extractLabels(std::vector<std::string> lines) {
-  auto bak = lines;
-  lines.clear();
-  std::regex re("[.a-zA-Z0-9_]*:", std::regex_constants::ECMAScript);
-  for (const auto &line : bak) {
-    std::smatch matchRes;
-    std::regex_search(line, matchRes, re);
-    if (matchRes.empty()) {
-      lines.emplace_back(line);
-      continue;
+// Split the source into statements in a single pass. Each line is cut at its
+// comment, if any, and trimmed. A label at the start of a line, i.e. a run of
+// [.a-zA-Z0-9_] followed by ':', becomes a statement of its own, and so does
+// the rest of the line. Empty statements are dropped.
+std::vector<std::string_view> splitIntoStatements(std::string_view src) {
+  std::vector<std::string_view> statements;
+  std::size_t pos = 0;
+  while (pos < src.size()) {
+    auto lineEnd = std::min(src.find('\n', pos), src.size());
+    // be careful with the case: .string "#"
+    auto end = lineEnd;
+    bool inString = false;
+    for (auto i = pos; i < lineEnd; ++i) {
+      auto ch = src[i];
+      if (!inString && ch == '#') {
+        end = i;
+        break;
+      }
+      if (ch == '"')
+        inString = !inString;
+      else if (inString && ch == '\\')
+        ++i;
     }
-    assert(matchRes.size() == 1); // at most one label per line
-    if (matchRes[0].first != line.begin()) {
-      lines.emplace_back(line);
-      continue;
+    while (pos < end && isSpace(src[pos]))
+      ++pos;
+    while (end > pos && isSpace(src[end - 1]))
+      --end;
+
+    auto labelEnd = pos;
+    while (labelEnd < end && isLabelChar(src[labelEnd]))
+      ++labelEnd;
+    if (labelEnd < end && src[labelEnd] == ':') {
+      statements.emplace_back(src.substr(pos, labelEnd + 1 - pos));
+      pos = labelEnd + 1;
+      while (pos < end && isSpace(src[pos]))
+        ++pos;
     }
-    lines.emplace_back(matchRes[0].first, matchRes[0].second);
-    assert(matchRes[0].second >= matchRes[0].first);
-    if (std::size_t(matchRes[0].second - matchRes[0].first) == line.length())
-      continue;
-    lines.emplace_back(matchRes[0].second, line.cend());
-    lines.back() = strip(lines.back());
-    if (lines.back().empty())
-      lines.pop_back();
+    if (pos < end)
+      statements.emplace_back(src.substr(pos, end - pos));
+    pos = lineEnd + 1;
   }
-  return lines;
+  return statements;
 }
 
-std::string translatePseudoInstruction(const std::string &line) {
-  using namespace std::string_literals;
-  auto tokens = tokenize(line);
+// Return the instruction which `tokens` stand for, or std::nullopt if they
+// are not a pseudo instruction
+std::optional<std::string_view>
+translatePseudoInstruction(const std::vector<std::string_view> &tokens,
+                           StringArena &arena) {
   auto opname = tokens.at(0);
   if (opname == "li" || opname == "call" || opname == "tail") {
     assert(false);
   }
   if (opname == "nop") {
-    return "addi x0, x0, 0"s;
+    return "addi x0, x0, 0";
   }
   if (opname == "mv") {
-    return "addi "s + tokens.at(1) + "," + tokens.at(2) + ",0";
+    return arena.concat({"addi ", tokens.at(1), ",", tokens.at(2), ",0"});
   }
   if (opname == "not") {
-    return "xori "s + tokens.at(1) + ", " + tokens.at(2) + ", -1";
+    return arena.concat({"xori ", tokens.at(1), ", ", tokens.at(2), ", -1"});
   }
   if (opname == "neg") {
-    return "sub "s + tokens.at(1) + ", x0, " + tokens.at(2);
+    return arena.concat({"sub ", tokens.at(1), ", x0, ", tokens.at(2)});
   }
   if (opname == "seqz") {
-    return "sltiu " + tokens.at(1) + ", " + tokens.at(2) + ", 1";
+    return arena.concat({"sltiu ", tokens.at(1), ", ", tokens.at(2), ", 1"});
   }
   if (opname == "snez") {
-    return "sltu " + tokens.at(1) + ", x0, " + tokens.at(2);
+    return arena.concat({"sltu ", tokens.at(1), ", x0, ", tokens.at(2)});
   }
   if (opname == "sltz") {
-    return "slt " + tokens.at(1) + ", " + tokens.at(2) + ", x0";
+    return arena.concat({"slt ", tokens.at(1), ", ", tokens.at(2), ", x0"});
   }
   if (opname == "sgtz") {
-    return "slt " + tokens.at(1) + ", x0, " + tokens.at(2);
+    return arena.concat({"slt ", tokens.at(1), ", x0, ", tokens.at(2)});
   }
 
   if (opname == "sgt") {
-    return "slt " + tokens.at(1) + ", " + tokens.at(3) + ", " + tokens.at(2);
+    return arena.concat(
+        {"slt ", tokens.at(1), ", ", tokens.at(3), ", ", tokens.at(2)});
   }
 
-  static const std::unordered_map<std::string, std::string> branchPair = {
-      {"bgt", "blt"}, {"ble", "bge"}, {"bgtu", "bltu"}, {"bleu", "bgeu"}};
+  static const std::unordered_map<std::string_view, std::string_view>
+      branchPair = {
+          {"bgt", "blt"}, {"ble", "bge"}, {"bgtu", "bltu"}, {"bleu", "bgeu"}};
   if (auto op = get(branchPair, opname)) {
-    return op.value() + " " + tokens.at(2) + "," + tokens.at(1) + "," +
-           tokens.at(3);
+    return arena.concat({op.value(), " ", tokens.at(2), ",", tokens.at(1),
+                         ",", tokens.at(3)});
   }
   if (opname.front() == 'b' && opname.back() == 'z') {
-    static const std::unordered_set<std::string> BranchZero = {
+    static const std::unordered_set<std::string_view> BranchZero = {
         "beqz", "bnez", "bgtz", "bltz", "blez", "bgez",
     };
     assert(isIn(BranchZero, opname));
-    opname.pop_back();
+    opname.remove_suffix(1);
     bool reverse = isIn(branchPair, opname);
     if (reverse)
       opname = branchPair.at(opname);
     auto rs1 = tokens.at(1);
-    auto rs2 = "x0"s;
+    std::string_view rs2 = "x0";
     if (reverse)
       std::swap(rs1, rs2);
-    return opname + " " + rs1 + ", " + rs2 + ", " + tokens.at(2);
+    return arena.concat({opname, " ", rs1, ", ", rs2, ", ", tokens.at(2)});
   }
 
   if (opname == "j") {
-    return "jal x0, "s + tokens.at(1);
+    return arena.concat({"jal x0, ", tokens.at(1)});
   }
   if (opname == "jal" && tokens.size() == 2) {
-    return "jal x1, "s + tokens[1];
+    return arena.concat({"jal x1, ", tokens[1]});
   }
   if (opname == "jr") {
-    return "jalr x0, 0(" + tokens.at(1) + ")";
+    return arena.concat({"jalr x0, 0(", tokens.at(1), ")"});
   }
   if (opname == "jalr" && tokens.size() == 2) {
-    return "jalr x1, 0(" + tokens.at(1) + ")";
+    return arena.concat({"jalr x1, 0(", tokens.at(1), ")"});
   }
   if (opname == "ret") {
-    return "jalr x0, 0(x1)"s;
+    return "jalr x0, 0(x1)";
   }
 
-  return line;
+  return std::nullopt;
 }
 
-std::vector<std::string>
-translatePseudoInstructions(std::vector<std::string> lines) {
+PreprocessedSource
+translatePseudoInstructions(const std::vector<std::string_view> &statements) {
   std::mt19937_64 eng(std::random_device{}());
   std::uniform_int_distribution<char> randomChar('a', 'z');
-  std::string prefix;
+  // a local label, like those emitted by compilers, cf. Profiler
+  std::string prefix = ".L";
   for (int i = 0; i < 8; ++i)
     prefix.push_back(randomChar(eng));
-  prefix += "_pseudo_inst_label_";
+  prefix += PseudoInstLabel;
   std::size_t newLabelCnt = 0;
-  auto newLabel = [&prefix, &newLabelCnt] {
-    return prefix + std::to_string(newLabelCnt++);
+  PreprocessedSource res;
+  auto &lines = res.statements;
+  auto &arena = res.expansions;
+  auto newLabel = [&prefix, &newLabelCnt, &arena] {
+    return arena.concat({prefix, std::to_string(newLabelCnt++)});
+  };
+  auto emit = [&lines, &arena](std::initializer_list<std::string_view> parts) {
+    lines.emplace_back(arena.concat(parts));
   };
 
-  auto bak = lines;
-  lines.clear();
-  for (auto &lineBak : bak) {
-    if (isLabel(lineBak) || isDirective(lineBak)) {
-      lines.emplace_back(lineBak);
+  lines.reserve(statements.size());
+  std::vector<std::string_view> tokens;
+  for (auto line : statements) {
+    if (isLabel(line) || isDirective(line)) {
+      lines.emplace_back(line);
       continue;
     }
-    auto tokens = tokenize(lineBak);
+    tokenize(line, tokens);
     auto op = tokens.front();
 
     // la, l{b|h|w}, s{b|h|w|d}
-    static const std::unordered_set<std::string> Mem = {"lb", "lh", "lw",
-                                                        "sb", "sh", "sw"};
+    static const std::unordered_set<std::string_view> Mem = {"lb", "lh", "lw",
+                                                             "sb", "sh", "sw"};
     // Note: Non-pseudo loads are for the form: lw rd, offset(reg)
     if (op == "la" || (isIn(Mem, op) && tokens.at(2).back() != ')')) {
       auto label = newLabel();
       auto rd = tokens.at(1);
       auto symbol = tokens.at(2);
-      lines.emplace_back(label + ":");
+      emit({label, ":"});
       if (op == "la") {
-        lines.emplace_back("auipc " + rd + ", %pcrel_hi(" + symbol + ")");
-        lines.emplace_back("addi " + rd + ", " + rd + ", %pcrel_lo(" + label +
-                           ")");
+        emit({"auipc ", rd, ", %pcrel_hi(", symbol, ")"});
+        emit({"addi ", rd, ", ", rd, ", %pcrel_lo(", label, ")"});
         continue;
       }
       if (op.front() == 'l') {
-        lines.emplace_back("auipc " + rd + ", %pcrel_hi(" + symbol + ")");
-        lines.emplace_back(op + " " + rd + ", %pcrel_lo(" + label + ")(" + rd +
-                           ")");
+        emit({"auipc ", rd, ", %pcrel_hi(", symbol, ")"});
+        emit({op, " ", rd, ", %pcrel_lo(", label, ")(", rd, ")"});
         continue;
       }
       if (op.front() == 's') {
         auto rt = tokens.at(3);
-        lines.emplace_back("auipc " + rt + ", %pcrel_hi(" + symbol + ")");
-        lines.emplace_back(op + " " + rd + ", %pcrel_lo(" + label + ")(" + rt +
-                           ")");
+        emit({"auipc ", rt, ", %pcrel_hi(", symbol, ")"});
+        emit({op, " ", rd, ", %pcrel_lo(", label, ")(", rt, ")"});
         continue;
       }
       assert(false);
@@ -211,51 +211,62 @@ translatePseudoInstructions(std::vector<std::string> lines) {
     // li
     if (op == "li") {
       auto rd = tokens.at(1);
-      auto imm = std::stoi(tokens.at(2), nullptr, 0);
+      auto imm = std::stoi(std::string(tokens.at(2)), nullptr, 0);
       auto uImm = std::uint32_t(imm) >> 12u;
       auto lImm = std::uint32_t(imm) & 0xfffu;
       if (uImm != 0) { // large imm
-        lines.emplace_back("lui " + rd + ", " + std::to_string(uImm));
-        lines.emplace_back("ori " + rd + ", " + rd + ", " +
-                           std::to_string(lImm));
+        emit({"lui ", rd, ", ", std::to_string(uImm)});
+        emit({"ori ", rd, ", ", rd, ", ", std::to_string(lImm)});
       } else {
-        lines.emplace_back("addi " + rd + ", zero, " + std::to_string(lImm));
+        emit({"addi ", rd, ", zero, ", std::to_string(lImm)});
       }
       continue;
     }
 
     // call, tail
     if (op == "call" || op == "tail") {
-      using namespace std::string_literals;
       auto funcName = tokens.at(1);
       auto label = newLabel();
-      lines.emplace_back(label + ":");
-      lines.emplace_back("auipc x6, %pcrel_hi(" + funcName + ")");
-      lines.emplace_back("jalr "s + (op == "call" ? "x1"s : "x0"s) +
-                         ", %pcrel_lo(" + label + ")(x6)");
+      emit({label, ":"});
+      emit({"auipc x6, %pcrel_hi(", funcName, ")"});
+      emit({"jalr ", op == "call" ? "x1" : "x0", ", %pcrel_lo(", label,
+            ")(x6)"});
       continue;
     }
 
-    lines.emplace_back(translatePseudoInstruction(lineBak));
+    auto inst = translatePseudoInstruction(tokens, arena);
+    lines.emplace_back(inst ? *inst : line);
   }
 
-  return lines;
+  return res;
 }
 
 } // namespace
 
-std::vector<std::string> preprocess(const std::string &src) {
-  auto lines = splitIntoLines(src);
-  for (auto &line : lines) {
-    line = removeComments(line);
-    line = strip(line);
+std::string_view
+StringArena::concat(std::initializer_list<std::string_view> parts) {
+  std::size_t size = 0;
+  for (auto part : parts)
+    size += part.size();
+  if (used + size > capacity) {
+    capacity = std::max(ChunkSize, size);
+    chunks.emplace_back(new char[capacity]);
+    used = 0;
   }
-  lines = extractLabels(std::move(lines));
-  // remove empty lines
-  lines.erase(std::remove_if(lines.begin(), lines.end(),
-                             [](auto &l) { return l.empty(); }),
-              lines.end());
-  return translatePseudoInstructions(std::move(lines));
+  auto begin = chunks.back().get() + used;
+  for (auto part : parts) {
+    std::copy(part.begin(), part.end(), chunks.back().get() + used);
+    used += part.size();
+  }
+  return {begin, size};
+}
+
+PreprocessedSource preprocess(const std::string &src) {
+  return translatePseudoInstructions(splitIntoStatements(src));
+}
+
+bool isPseudoInstLabel(const std::string &label) {
+  return label.find(PseudoInstLabel) != std::string::npos;
 }
 
 } // namespace ravel
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "ravel/guest_memory.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define RAVEL_HAS_MMAP
+#endif
+
+namespace ravel {
+namespace {
+
+#ifdef RAVEL_HAS_MMAP
+
+std::size_t roundUp(std::size_t n, std::size_t align) {
+  return (n + align - 1) / align * align;
+}
+
+// The guard regions, as (begin, end). Rarely more than one.
+std::vector<std::pair<std::byte *, std::byte *>> guardedRanges;
+
+thread_local sigjmp_buf *faultJmpBuf = nullptr;
+thread_local std::byte *faultAddr = nullptr;
+struct sigaction previousAction;
+volatile std::sig_atomic_t handlerInstalled = false;
+
+void handleSegv(int sig, siginfo_t *info, void *context) {
+  auto addr = (std::byte *)info->si_addr;
+  bool isGuard = std::any_of(
+      guardedRanges.begin(), guardedRanges.end(),
+      [addr](auto &range) { return range.first <= addr && addr < range.second; });
+  if (faultJmpBuf && isGuard) {
+    faultAddr = addr;
+    siglongjmp(*faultJmpBuf, 1);
+  }
+  // Not ours. Chain to the previous handler, or, if it is the default action,
+  // restore it so that the access is retried with it. In that case this
+  // handler is installed again by the next runGuarded().
+  if (previousAction.sa_flags & SA_SIGINFO) {
+    previousAction.sa_sigaction(sig, info, context);
+    return;
+  }
+  if (previousAction.sa_handler != SIG_DFL &&
+      previousAction.sa_handler != SIG_IGN) {
+    previousAction.sa_handler(sig);
+    return;
+  }
+  sigaction(SIGSEGV, &previousAction, nullptr);
+  handlerInstalled = false;
+}
+
+void installHandler() {
+  if (handlerInstalled)
+    return;
+  handlerInstalled = true;
+  struct sigaction action = {};
+  action.sa_sigaction = &handleSegv;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGSEGV, &action, &previousAction);
+}
+
+#endif
+
+} // namespace
+
+GuestMemory::GuestMemory(std::size_t size, bool lazy, bool guarded)
+    : size(size) {
+#ifdef RAVEL_HAS_MMAP
+  if (lazy && guarded && mapGuarded())
+    return;
+  if (lazy) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p != MAP_FAILED) {
+      mapping = storageBegin = (std::byte *)p;
+      mappingSize = size;
+      return;
+    }
+  }
+#else
+  (void)lazy;
+  (void)guarded;
+#endif
+  fallback.resize(size);
+  storageBegin = fallback.data();
+}
+
+GuestMemory::~GuestMemory() {
+#ifdef RAVEL_HAS_MMAP
+  if (!mapping)
+    return;
+  if (guarded) {
+    guardedRanges.erase(std::remove(guardedRanges.begin(), guardedRanges.end(),
+                                    std::make_pair(mapping,
+                                                   mapping + mappingSize)),
+                        guardedRanges.end());
+  }
+  munmap(mapping, mappingSize);
+#endif
+}
+
+bool GuestMemory::mapGuarded() {
+#ifdef RAVEL_HAS_MMAP
+  // Layout: | guard | storage | guard, >= 4 GiB |
+  // The storage ends on a page boundary, so that the first byte after it is
+  // already in the guard region.
+  std::size_t pageSize = sysconf(_SC_PAGESIZE);
+  std::size_t guardSize = roundUp(64 * 1024, pageSize);
+  std::size_t dataSize = roundUp(size, pageSize);
+  std::uint64_t highGuardSize = ((std::uint64_t)1 << 32u) + guardSize;
+  if (highGuardSize > SIZE_MAX - guardSize - dataSize)
+    return false;
+  std::size_t total = guardSize + dataSize + highGuardSize;
+
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  void *p = mmap(nullptr, total, PROT_NONE, flags, -1, 0);
+  if (p == MAP_FAILED)
+    return false;
+  auto base = (std::byte *)p;
+  if (mprotect(base + guardSize, dataSize, PROT_READ | PROT_WRITE) != 0) {
+    munmap(base, total);
+    return false;
+  }
+
+  mapping = base;
+  mappingSize = total;
+  storageBegin = base + guardSize + dataSize - size;
+  guarded = true;
+  installHandler();
+  guardedRanges.emplace_back(mapping, mapping + mappingSize);
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::optional<std::byte *> runGuarded(void (*func)(void *), void *context) {
+#ifdef RAVEL_HAS_MMAP
+  installHandler();
+  // Restores the enclosing jump buffer however this returns. It is alive at
+  // sigsetjmp(), so a fault only skips the frames of `func`.
+  struct Restore {
+    sigjmp_buf *previous = faultJmpBuf;
+    ~Restore() { faultJmpBuf = previous; }
+  } restore;
+  sigjmp_buf jmpBuf;
+  if (sigsetjmp(jmpBuf, 1))
+    return faultAddr;
+  faultJmpBuf = &jmpBuf;
+  func(context);
+  return std::nullopt;
+#else
+  func(context);
+  return std::nullopt;
+#endif
+}
+
+UnguardedScope::UnguardedScope() {
+#ifdef RAVEL_HAS_MMAP
+  previous = faultJmpBuf;
+  faultJmpBuf = nullptr;
+#endif
+}
+
+UnguardedScope::~UnguardedScope() {
+#ifdef RAVEL_HAS_MMAP
+  faultJmpBuf = (sigjmp_buf *)previous;
+#endif
+}
+
+} // namespace ravel
@@ -0,0 +1,75 @@
+#include "ravel/interpreter/annotator.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <string>
+
+#include "ravel/assembler/parser.h"
+#include "ravel/assembler/preprocessor.h"
+
+namespace ravel {
+
+void Annotator::print(std::ostream &os, const InstCost &instCost,
+                      const Profiler::TimeFunc &time,
+                      std::size_t totalTime) const {
+  // The # of executions of each slot. Overlapping blocks end at the same
+  // place, so the counts of the blocks covering a slot can be summed up in a
+  // single pass.
+  std::vector<std::size_t> execs(slots.size());
+  std::size_t running = 0;
+  for (std::size_t slot = 0; slot < slots.size(); ++slot) {
+    running += slots[slot].blockCount;
+    execs[slot] = running + slots[slot].instCount;
+    if (decodedInsts[slot].op == DecodedInst::Invalid ||
+        blockCache.endsBlock(slot))
+      running = 0;
+  }
+
+  const auto &insts = interpretable.getInsts();
+  const auto &positions = interpretable.getInstPositions();
+  std::vector<std::size_t> order(insts.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&positions](auto lhs, auto rhs) {
+              return positions[lhs] < positions[rhs];
+            });
+
+  auto flags = os.flags();
+  auto total = std::max<std::size_t>(totalTime, 1);
+  os << std::setw(10) << "count" << std::setw(9) << "share" << std::setw(10)
+     << "L1 hit" << std::setw(10) << "mem" << '\n';
+  const auto &symbols = interpretable.getSymbols();
+  auto symbol = symbols.begin();
+  for (auto i : order) {
+    auto pos = positions[i];
+    // skip _start and the placeholders of the C library functions
+    if (pos < libc::LibcFuncEndAddr)
+      continue;
+    for (; symbol != symbols.end() && symbol->second <= pos; ++symbol) {
+      if (symbol->second == pos && !isPseudoInstLabel(symbol->first))
+        os << std::string(43, ' ') << symbol->first << ":\n";
+    }
+
+    auto slot = pos / 4;
+    const auto &entry = slots[slot];
+    // the instructions of the block are attributed to each of them instead
+    auto others = entry.counters;
+    others.simple = others.mul = others.br = others.div = 0;
+    auto cost = execs[slot] * instCost(decodedInsts[slot]) + time(others);
+    os << std::setw(10) << execs[slot] << std::setw(8) << std::fixed
+       << std::setprecision(2) << 100.0 * cost / total << '%';
+    if (entry.blockCount != 0 || entry.instCount != 0)
+      os << std::setw(10) << entry.counters.cache << std::setw(10)
+         << entry.counters.mem;
+    else
+      os << std::string(20, ' ');
+    os << "    " << toString(insts[i]);
+    if (!insts[i]->getComment().empty())
+      os << "  # " << insts[i]->getComment();
+    os << '\n';
+  }
+  os.flags(flags);
+}
+
+} // namespace ravel
@@ -0,0 +1,78 @@
+#include "ravel/interpreter/block_cache.h"
+
+#include <cassert>
+
+#include "ravel/linker/interpretable.h"
+
+namespace ravel {
+namespace {
+
+bool isReserved(std::size_t slot) {
+  return Interpretable::End <= slot * 4 &&
+         slot * 4 < Interpretable::LibcFuncEnd;
+}
+
+bool transfersControl(inst::Instruction::OpType op) {
+  return inst::Instruction::JAL <= op && op <= inst::Instruction::BGEU;
+}
+
+bool writesX0(const DecodedInst &inst) {
+  using Op = inst::Instruction::OpType;
+  auto op = (Op)inst.op;
+  bool hasDest = !(Op::BEQ <= op && op <= Op::BGEU) &&
+                 !(Op::SB <= op && op <= Op::SW);
+  return hasDest && inst.rd == 0;
+}
+
+} // namespace
+
+bool BasicBlockCache::isValid(std::size_t slot) const {
+  return slot < decodedInsts.size() &&
+         decodedInsts[slot].op != DecodedInst::Invalid && !isReserved(slot);
+}
+
+bool BasicBlockCache::endsBlock(std::size_t slot) const {
+  const auto &inst = decodedInsts[slot];
+  return transfersControl((inst::Instruction::OpType)inst.op) ||
+         writesX0(inst) || !isValid(slot + 1);
+}
+
+void BasicBlockCache::build(std::size_t slot) {
+  if (!isValid(slot)) {
+    slot2Block[slot] = NoBlock;
+    return;
+  }
+
+  BasicBlock block;
+  block.entry = slot * 4;
+  for (auto i = slot;; ++i) {
+    const auto &inst = decodedInsts[i];
+    block.insts.emplace_back(inst);
+
+    switch (getInstClass(inst)) {
+    case InstClass::Simple:
+      ++block.simple;
+      break;
+    case InstClass::Mul:
+      ++block.mul;
+      break;
+    case InstClass::Div:
+      ++block.div;
+      break;
+    case InstClass::Branch:
+      ++block.br;
+      break;
+    case InstClass::MemAccess:
+      break;
+    }
+
+    if (endsBlock(i))
+      break;
+  }
+
+  blocks.emplace_back(std::move(block));
+  slot2Block[slot] = blocks.size();
+  assert(slot2Block[slot] != NoBlock);
+}
+
+} // namespace ravel
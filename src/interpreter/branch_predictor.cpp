@@ -0,0 +1,79 @@
+#include "ravel/interpreter/branch_predictor.h"
+
+#include "ravel/error.h"
+
+namespace ravel {
+
+BranchPredictor::BranchPredictor(const BranchPredictorConfig &config,
+                                 std::size_t numSlots)
+    : config(config), stats(numSlots) {
+  if (config.tableBits > 24 || config.historyBits > 24 ||
+      config.btbEntries == 0 ||
+      (config.btbEntries & (config.btbEntries - 1)) != 0)
+    throw Exception("Invalid branch predictor configuration");
+  // weakly not taken
+  counters.assign(std::size_t(1) << config.tableBits, 1);
+  btb.resize(config.btbEntries);
+}
+
+bool BranchPredictor::branch(std::uint32_t pc, bool taken) {
+  bool mispredicted = predict(pc) != taken;
+  update(pc, taken);
+  auto &entry = stats[pc / 4];
+  ++entry.executed;
+  entry.taken += taken;
+  entry.mispredicted += mispredicted;
+  mispredictions += mispredicted;
+  return mispredicted;
+}
+
+bool BranchPredictor::jump(std::uint32_t pc, std::uint32_t target) {
+  auto &entry = btb[(pc / 4) & (btb.size() - 1)];
+  bool mispredicted = !entry.valid || entry.pc != pc || entry.target != target;
+  entry = {pc, target, true};
+  auto &stat = stats[pc / 4];
+  ++stat.executed;
+  ++stat.taken;
+  stat.mispredicted += mispredicted;
+  mispredictions += mispredicted;
+  return mispredicted;
+}
+
+void BranchPredictor::printStats(std::ostream &os) const {
+  os << "pc,executed,taken,mispredicted\n";
+  for (std::size_t i = 0; i < stats.size(); ++i) {
+    const auto &entry = stats[i];
+    if (entry.executed == 0)
+      continue;
+    os << i * 4 << ',' << entry.executed << ',' << entry.taken << ','
+       << entry.mispredicted << '\n';
+  }
+}
+
+bool BranchPredictor::predict(std::uint32_t pc) const {
+  if (config.kind == BranchPredictorKind::StaticNotTaken)
+    return false;
+  return counters[getCounterIndex(pc)] >= 2;
+}
+
+void BranchPredictor::update(std::uint32_t pc, bool taken) {
+  if (config.kind == BranchPredictorKind::StaticNotTaken)
+    return;
+  auto &counter = counters[getCounterIndex(pc)];
+  if (taken && counter < 3)
+    ++counter;
+  else if (!taken && counter > 0)
+    --counter;
+  if (config.kind == BranchPredictorKind::Gshare)
+    history = ((history << 1u) | taken) &
+              ((std::uint32_t(1) << config.historyBits) - 1);
+}
+
+std::size_t BranchPredictor::getCounterIndex(std::uint32_t pc) const {
+  std::size_t idx = pc / 4;
+  if (config.kind == BranchPredictorKind::Gshare)
+    idx ^= history;
+  return idx & (counters.size() - 1);
+}
+
+} // namespace ravel
@@ -1,52 +1,193 @@
 #include "ravel/interpreter/cache.h"
 
-#include "ravel/error.h"
+#include <algorithm>
 
 namespace ravel {
+namespace {
 
-std::uint32_t Cache::fetchWord(std::size_t addr) {
-  std::size_t memorySize = storageEnd - storageBegin;
-  if (addr + 4 > memorySize) {
-    throw InvalidAddress(addr);
+bool isPowerOfTwo(std::size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+} // namespace
+
+CacheLevel::CacheLevel(const CacheConfig &config) : config(config) {
+  if (!isPowerOfTwo(config.sets) || !isPowerOfTwo(config.lineSize) ||
+      config.ways == 0)
+    throw Exception("Invalid cache configuration");
+  ways = config.ways;
+  while ((std::size_t(1) << lineSizePow) < config.lineSize)
+    ++lineSizePow;
+  setMask = config.sets - 1;
+  lines.resize(config.sets * config.ways);
+}
+
+bool CacheLevel::contains(std::size_t addr) {
+  auto tag = addr >> lineSizePow;
+  auto set = getSet(tag);
+  for (std::size_t i = 0; i < ways; ++i) {
+    if (set[i].valid && set[i].tag == tag)
+      return true;
+  }
+  return false;
+}
+
+std::optional<std::size_t> CacheLevel::insert(std::size_t addr,
+                                              std::size_t cycles,
+                                              std::size_t accesses,
+                                              bool prefetched) {
+  auto tag = addr >> lineSizePow;
+  auto &line = getVictim(getSet(tag), cycles);
+  std::optional<std::size_t> evicted;
+  if (line.valid)
+    evicted = line.tag << lineSizePow;
+  line.lastUsed = cycles;
+  line.lastAccess = line.filled = accesses;
+  line.valid = true;
+  line.prefetched = prefetched;
+  line.tag = tag;
+  return evicted;
+}
+
+void CacheLevel::invalidate(std::size_t addr) {
+  auto tag = addr >> lineSizePow;
+  auto set = getSet(tag);
+  for (std::size_t i = 0; i < ways; ++i) {
+    if (set[i].valid && set[i].tag == tag)
+      set[i].valid = false;
+  }
+}
+
+CacheLevel::Line &CacheLevel::getVictim(Line *set, std::size_t cycles) {
+  for (std::size_t i = 0; i < ways; ++i) {
+    if (!set[i].valid)
+      return set[i];
   }
-  if (disabled) {
+
+  std::size_t resIdx = 0;
+  switch (config.policy) {
+  case ReplacementPolicy::Idle:
+    for (std::size_t i = 0; i < ways; ++i) {
+      if (cycles >= set[i].lastUsed + 32)
+        resIdx = i;
+    }
+    break;
+  case ReplacementPolicy::Lru:
+    for (std::size_t i = 1; i < ways; ++i) {
+      if (set[i].lastAccess < set[resIdx].lastAccess)
+        resIdx = i;
+    }
+    break;
+  case ReplacementPolicy::Fifo:
+    for (std::size_t i = 1; i < ways; ++i) {
+      if (set[i].filled < set[resIdx].filled)
+        resIdx = i;
+    }
+    break;
+  case ReplacementPolicy::Random:
+    // xorshift32, so that the results are reproducible
+    randomState ^= randomState << 13u;
+    randomState ^= randomState >> 17u;
+    randomState ^= randomState << 5u;
+    resIdx = randomState % ways;
+    break;
+  }
+  return set[resIdx];
+}
+
+void InstCache::fetch(std::size_t pc, std::size_t n) {
+  auto lineSize = level.getConfig().lineSize;
+  auto end = pc + 4 * n;
+  while (pc < end) {
+    auto lineEnd = std::min(end, (pc & ~(lineSize - 1)) + lineSize);
+    auto cnt = (lineEnd - pc + 3) / 4;
+    ++fetches;
+    if (level.lookup(pc, fetches, fetches)) {
+      hit++;
+    } else {
+      level.insert(pc, fetches, fetches);
+      miss++;
+    }
+    // The rest of the instructions in the line hit.
+    if (cnt > 1) {
+      fetches += cnt - 1;
+      hit += cnt - 1;
+      level.lookup(pc, fetches, fetches);
+    }
+    pc += 4 * cnt;
+  }
+}
+
+void Cache::configure(const std::vector<CacheConfig> &configs,
+                      InclusionPolicy newInclusion) {
+  if (configs.empty())
+    throw Exception("Invalid cache configuration");
+  levels.clear();
+  for (auto &config : configs) {
+    if (newInclusion == InclusionPolicy::Exclusive &&
+        config.lineSize != configs.front().lineSize)
+      throw Exception("The levels of an exclusive cache must have the same "
+                      "line size");
+    levels.emplace_back(config);
+  }
+  inclusion = newInclusion;
+  prefetcher.reset();
+}
+
+void Cache::fetchFromLowerLevels(std::size_t addr) {
+  std::size_t found = 1;
+  while (found < levels.size() && !levels[found].lookup(addr, cycles, accesses))
+    ++found;
+  if (found == levels.size())
     miss++;
-    return *(std::uint32_t *)(storageBegin + addr);
+  fill(addr, found, false);
+}
+
+void Cache::fill(std::size_t addr, std::size_t found, bool prefetched) {
+  if (inclusion == InclusionPolicy::Exclusive) {
+    if (found < levels.size())
+      levels[found].invalidate(addr);
+    auto victim = levels.front().insert(addr, cycles, accesses, prefetched);
+    for (std::size_t i = 1; victim && i < levels.size(); ++i)
+      victim = levels[i].insert(*victim, cycles, accesses);
+    return;
   }
-  for (auto &line : lines) {
-    if (!line.valid)
+
+  // Fill the levels which missed, from the bottom, so that a line evicted
+  // from a level can be evicted from the levels above it.
+  for (std::size_t i = found; i-- > 0;) {
+    auto victim =
+        levels[i].insert(addr, cycles, accesses, i == 0 && prefetched);
+    if (!victim)
       continue;
-    if ((Mask & addr) != (Mask & line.addr))
+    auto lineSize = levels[i].getConfig().lineSize;
+    for (std::size_t j = 0; j < i; ++j) {
+      auto step = levels[j].getConfig().lineSize;
+      for (auto a = *victim; a < *victim + lineSize; a += step)
+        levels[j].invalidate(a);
+    }
+  }
+}
+
+void Cache::prefetch(std::size_t addr) {
+  for (auto target : prefetcher->access(addr)) {
+    if (target >= storageSize() || levels.front().contains(target))
       continue;
-    // hit
-    line.lastUsed = cycles;
-    hit++;
-    return *(std::uint32_t *)(storageBegin + addr);
+    ++prefetches;
+    // The lower levels are probed without counting, so that prefetches have
+    // no cost.
+    std::size_t found = 1;
+    while (found < levels.size() && !levels[found].contains(target))
+      ++found;
+    fill(target, found, true);
+  }
+}
+
+void Cache::notifyObservers(std::size_t addr) {
+  if (missRatioCurve)
+    missRatioCurve->access(addr);
+  for (auto follower : followers) {
+    follower->cycles = cycles;
+    follower->access(addr);
   }
-  // miss
-  auto &line = getEmptyLine();
-  line.lastUsed = cycles;
-  line.valid = true;
-  line.addr = addr & Mask;
-  miss++;
-  return *(std::uint32_t *)(storageBegin + addr);
-}
-
-Cache::Line &Cache::getEmptyLine() {
-  std::size_t resIdx = lines.size();
-  for (std::size_t i = 0; i < lines.size(); ++i) {
-    if (!lines[i].valid)
-      return lines[i];
-    if (cycles >= lines[i].lastUsed + 32)
-      resIdx = i;
-  }
-  if (resIdx != lines.size())
-    return lines[resIdx];
-  auto &res = lines[0];
-  victimIdx += 7;
-  victimIdx %= 16;
-  res.valid = false;
-  return res;
 }
 
 } // namespace ravel
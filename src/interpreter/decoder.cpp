@@ -0,0 +1,91 @@
+#include "ravel/interpreter/decoder.h"
+
+#include <cassert>
+
+namespace ravel {
+namespace {
+
+std::uint8_t reg(std::size_t regNumber) {
+  assert(regNumber < 32);
+  return (std::uint8_t)regNumber;
+}
+
+} // namespace
+
+DecodedInst decode(const inst::Instruction &inst) {
+  using Op = inst::Instruction::OpType;
+  auto op = inst.getOp();
+  DecodedInst res;
+  res.op = (std::uint8_t)op;
+
+  if (Op::LUI <= op && op <= Op::AUIPC) {
+    auto &p = static_cast<const inst::ImmConstruction &>(inst);
+    res.rd = reg(p.getDest());
+    res.imm = (std::int32_t)(p.getImm() << 12u);
+    return res;
+  }
+  if (op == Op::JAL) {
+    auto &p = static_cast<const inst::JumpLink &>(inst);
+    res.rd = reg(p.getDest());
+    res.imm = p.getOffset() * 2;
+    return res;
+  }
+  if (op == Op::JALR) {
+    auto &p = static_cast<const inst::JumpLinkReg &>(inst);
+    res.rd = reg(p.getDest());
+    res.rs1 = reg(p.getBase());
+    res.imm = p.getOffset();
+    return res;
+  }
+  if (Op::BEQ <= op && op <= Op::BGEU) {
+    auto &p = static_cast<const inst::Branch &>(inst);
+    res.rs1 = reg(p.getSrc1());
+    res.rs2 = reg(p.getSrc2());
+    res.imm = p.getOffset();
+    return res;
+  }
+  if (Op::LB <= op && op <= Op::SW) {
+    auto &p = static_cast<const inst::MemAccess &>(inst);
+    res.rs1 = reg(p.getBase());
+    if (op <= Op::LHU)
+      res.rd = reg(p.getReg());
+    else
+      res.rs2 = reg(p.getReg());
+    res.imm = p.getOffset();
+    return res;
+  }
+  if (Op::ADDI <= op && op <= Op::SRAI) {
+    auto &p = static_cast<const inst::ArithRegImm &>(inst);
+    res.rd = reg(p.getDest());
+    res.rs1 = reg(p.getSrc());
+    res.imm = p.getImm();
+    return res;
+  }
+  if (Op::ADD <= op && op <= Op::AND) {
+    auto &p = static_cast<const inst::ArithRegReg &>(inst);
+    res.rd = reg(p.getDest());
+    res.rs1 = reg(p.getSrc1());
+    res.rs2 = reg(p.getSrc2());
+    return res;
+  }
+  assert(Op::MUL <= op && op <= Op::REMU);
+  auto &p = static_cast<const inst::MArith &>(inst);
+  res.rd = reg(p.getDest());
+  res.rs1 = reg(p.getSrc1());
+  res.rs2 = reg(p.getSrc2());
+  return res;
+}
+
+std::vector<DecodedInst> decode(const Interpretable &interpretable) {
+  const auto &insts = interpretable.getInsts();
+  const auto &positions = interpretable.getInstPositions();
+  std::vector<DecodedInst> table(interpretable.getStorage().size() / 4);
+  for (std::size_t i = 0; i < insts.size(); ++i) {
+    auto pos = positions[i];
+    assert(pos % 4 == 0 && pos / 4 < table.size());
+    table[pos / 4] = decode(*insts[i]);
+  }
+  return table;
+}
+
+} // namespace ravel
@@ -0,0 +1,105 @@
+#include "ravel/interpreter/heap_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace ravel {
+
+void HeapAllocator::reset(std::size_t heapBegin) {
+  top = peakTop = heapBegin;
+  allocated.clear();
+  freeBlocks.clear();
+  for (auto &bin : bins)
+    bin.clear();
+}
+
+HeapAllocator::Block HeapAllocator::allocate(std::size_t size) {
+  Block block;
+  block.size = size;
+
+  // Except possibly the first one, blocks start at even addresses.
+  std::size_t needed = getEnd(0, size);
+  for (auto i = binOf(needed); i < NumBins; ++i) {
+    auto &bin = bins[i];
+    auto iter = bin.lower_bound({needed, 0});
+    while (iter != bin.end() && getEnd(iter->second, size) >
+                                    iter->second + iter->first)
+      ++iter;
+    if (iter == bin.end())
+      continue;
+
+    auto [freeSize, freeAddr] = *iter;
+    eraseFree(freeAddr, freeSize);
+    block.addr = freeAddr;
+    block.end = getEnd(freeAddr, size);
+    if (block.end < freeAddr + freeSize)
+      insertFree(block.end, freeAddr + freeSize - block.end);
+    allocated.emplace(block.addr, block);
+    return block;
+  }
+
+  block.addr = top;
+  block.end = top = getEnd(top, size);
+  peakTop = std::max(peakTop, top);
+  allocated.emplace(block.addr, block);
+  return block;
+}
+
+std::optional<HeapAllocator::Block>
+HeapAllocator::deallocate(std::size_t addr) {
+  auto iter = allocated.find(addr);
+  if (iter == allocated.end())
+    return std::nullopt;
+  auto block = iter->second;
+  allocated.erase(iter);
+
+  auto begin = block.addr;
+  auto end = block.end;
+  // coalesce with the neighbours
+  auto next = freeBlocks.lower_bound(end);
+  if (next != freeBlocks.end() && next->first == end) {
+    end += next->second;
+    eraseFree(next->first, next->second);
+  }
+  auto prev = freeBlocks.lower_bound(begin);
+  if (prev != freeBlocks.begin()) {
+    --prev;
+    if (prev->first + prev->second == begin) {
+      begin = prev->first;
+      eraseFree(prev->first, prev->second);
+    }
+  }
+
+  if (end == top)
+    top = begin;
+  else
+    insertFree(begin, end - begin);
+  return block;
+}
+
+std::size_t HeapAllocator::binOf(std::size_t size) {
+  assert(size > 0);
+  std::size_t bin = 0;
+  while (size >>= 1u)
+    ++bin;
+  return bin;
+}
+
+std::size_t HeapAllocator::getEnd(std::size_t addr, std::size_t size) {
+  auto end = addr + size + 1; // at least one byte of red zone
+  if (end % 2)
+    ++end;
+  return end;
+}
+
+void HeapAllocator::insertFree(std::size_t addr, std::size_t size) {
+  freeBlocks.emplace(addr, size);
+  bins[binOf(size)].emplace(size, addr);
+}
+
+void HeapAllocator::eraseFree(std::size_t addr, std::size_t size) {
+  freeBlocks.erase(addr);
+  bins[binOf(size)].erase({size, addr});
+}
+
+} // namespace ravel
@@ -0,0 +1,205 @@
+#include "ravel/interpreter/inst_trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef RAVEL_ZLIB
+#include <zlib.h>
+#endif
+
+#include "ravel/error.h"
+
+namespace ravel {
+namespace {
+
+constexpr char Magic[8] = {'R', 'A', 'V', 'E', 'L', 'T', 'R', '1'};
+
+} // namespace
+
+InstTraceWriter::InstTraceWriter(
+    const std::string &fileName, bool compress,
+    const std::vector<std::pair<std::string, std::size_t>> &symbols)
+    : file(std::fopen(fileName.c_str(), "wb")), compress(compress),
+      buffer(inst_trace::BlockSize + MaxRecordSize) {
+  if (!file)
+    throw Exception("Can not open file " + fileName);
+#ifndef RAVEL_ZLIB
+  if (compress) {
+    std::fclose(file);
+    throw Exception("Compressed traces are not supported by this build");
+  }
+#endif
+  write(Magic, sizeof(Magic));
+  std::uint32_t fileFlags = compress ? inst_trace::Compressed : 0;
+  write(&fileFlags, 4);
+  std::vector<std::pair<std::string, std::uint32_t>> recorded;
+  for (auto &[name, addr] : symbols) {
+    if (name.front() != '.')
+      recorded.emplace_back(name, addr);
+  }
+  std::uint32_t numSymbols = recorded.size();
+  write(&numSymbols, 4);
+  for (auto &[name, addr] : recorded) {
+    std::uint32_t length = name.size();
+    write(&addr, 4);
+    write(&length, 4);
+    write(name.data(), length);
+  }
+}
+
+InstTraceWriter::~InstTraceWriter() {
+  try {
+    flushBlock();
+  } catch (Exception &) {
+    // the trace is truncated, which the reader reports
+  }
+  std::fclose(file);
+}
+
+void InstTraceWriter::flushBlock() {
+  if (size == 0)
+    return;
+  std::uint32_t rawSize = size;
+  const std::uint8_t *data = buffer.data();
+  std::uint32_t storedSize = size;
+#ifdef RAVEL_ZLIB
+  if (compress) {
+    auto bound = compressBound(size);
+    compressed.resize(bound);
+    // the fastest level, since the trace is written while simulating
+    if (compress2(compressed.data(), &bound, buffer.data(), size, 1) != Z_OK)
+      throw Exception("Failed to compress the trace");
+    data = compressed.data();
+    storedSize = bound;
+  }
+#endif
+  write(&rawSize, 4);
+  write(&storedSize, 4);
+  write(data, storedSize);
+  size = 0;
+  lastPc = lastAddr = 0;
+}
+
+void InstTraceWriter::write(const void *data, std::size_t n) {
+  if (std::fwrite(data, 1, n, file) != n)
+    throw Exception("Failed to write the trace");
+}
+
+InstTraceReader::InstTraceReader(const std::string &fileName)
+    : file(std::fopen(fileName.c_str(), "rb")) {
+  if (!file)
+    throw Exception("Can not open file " + fileName);
+  char magic[sizeof(Magic)];
+  std::uint32_t fileFlags = 0;
+  std::uint32_t numSymbols = 0;
+  try {
+    read(magic, sizeof(magic));
+    if (std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+      throw Exception("Invalid trace file " + fileName);
+    read(&fileFlags, 4);
+    compressed = fileFlags & inst_trace::Compressed;
+#ifndef RAVEL_ZLIB
+    if (compressed)
+      throw Exception("Compressed traces are not supported by this build");
+#endif
+    read(&numSymbols, 4);
+    for (std::uint32_t i = 0; i < numSymbols; ++i) {
+      std::uint32_t addr = 0, length = 0;
+      read(&addr, 4);
+      read(&length, 4);
+      std::string name(length, '\0');
+      read(name.data(), length);
+      symbols.emplace_back(name, addr);
+    }
+  } catch (...) {
+    std::fclose(file);
+    throw;
+  }
+  std::stable_sort(symbols.begin(), symbols.end(),
+                   [](auto &lhs, auto &rhs) { return lhs.second < rhs.second; });
+}
+
+InstTraceReader::~InstTraceReader() { std::fclose(file); }
+
+bool InstTraceReader::next(InstTraceRecord &record) {
+  if (pos == block.size() && !readBlock())
+    return false;
+  auto flags = block[pos++];
+  record = InstTraceRecord();
+  record.pc = lastPc + 4;
+  if (flags & inst_trace::Jump) {
+    auto n = readVarint();
+    record.pc += std::int64_t(n >> 1u) ^ -std::int64_t(n & 1u);
+  }
+  lastPc = record.pc;
+  if (flags & inst_trace::Mem) {
+    auto n = readVarint();
+    record.hasAddr = true;
+    record.addr = lastAddr + (std::int64_t(n >> 1u) ^ -std::int64_t(n & 1u));
+    lastAddr = record.addr;
+  }
+  if (flags & inst_trace::Reg) {
+    if (pos == block.size())
+      throw Exception("Truncated trace");
+    record.hasReg = true;
+    record.reg = block[pos++];
+    record.value = readVarint();
+  }
+  return true;
+}
+
+std::pair<std::string, std::uint32_t>
+InstTraceReader::getFunction(std::uint32_t pc) const {
+  auto iter = std::upper_bound(
+      symbols.begin(), symbols.end(), pc,
+      [](std::uint32_t pc, auto &symbol) { return pc < symbol.second; });
+  if (iter == symbols.begin())
+    return {"", pc};
+  --iter;
+  return {iter->first, pc - iter->second};
+}
+
+bool InstTraceReader::readBlock() {
+  std::uint32_t rawSize = 0, storedSize = 0;
+  if (std::fread(&rawSize, 1, 4, file) != 4)
+    return false;
+  read(&storedSize, 4);
+  block.resize(rawSize);
+  if (!compressed) {
+    if (storedSize != rawSize)
+      throw Exception("Invalid trace block");
+    read(block.data(), rawSize);
+  } else {
+#ifdef RAVEL_ZLIB
+    stored.resize(storedSize);
+    read(stored.data(), storedSize);
+    uLongf size = rawSize;
+    if (uncompress(block.data(), &size, stored.data(), storedSize) != Z_OK ||
+        size != rawSize)
+      throw Exception("Invalid trace block");
+#endif
+  }
+  pos = 0;
+  lastPc = lastAddr = 0;
+  return rawSize != 0 || readBlock();
+}
+
+void InstTraceReader::read(void *data, std::size_t n) {
+  if (std::fread(data, 1, n, file) != n)
+    throw Exception("Truncated trace");
+}
+
+std::uint64_t InstTraceReader::readVarint() {
+  std::uint64_t n = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos == block.size())
+      throw Exception("Truncated trace");
+    auto byte = block[pos++];
+    n |= std::uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return n;
+  }
+  throw Exception("Invalid trace record");
+}
+
+} // namespace ravel
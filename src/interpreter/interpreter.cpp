@@ -7,9 +7,13 @@
 #include <memory>
 #include <queue>
 #include <stack>
+#include <thread>
+#include <type_traits>
 
 #include "ravel/assembler/parser.h"
 #include "ravel/error.h"
+#include "ravel/guest_memory.h"
+#include "ravel/interpreter/jit.h"
 #include "ravel/interpreter/libc_sim.h"
 
 namespace ravel {
@@ -20,12 +24,45 @@ const T &spc(const std::shared_ptr<inst::Instruction> &inst) {
   return static_cast<const T &>(*inst);
 }
 
+// The address of the word fetched through the cache by a memory access to
+// `vAddr`.
+std::size_t getFetchAddress(inst::Instruction::OpType op, std::size_t vAddr) {
+  using Op = inst::Instruction::OpType;
+  // To avoid memory access error when accessing with byte or half-word, we
+  // need to change the address to a proper one.
+  // For example, we need to access a memory at one byte below the stack
+  // pointer, we cannot fetch a word from the address, since will cause a
+  // memory access error. Instead, we need to fetch a word from the address
+  // 4 bytes below the stack pointer, and then extract the byte we need.
+  std::size_t fetchFrom = vAddr;
+  switch (op) {
+  case Op::SB:
+  case Op::LB:
+  case Op::LBU:
+    fetchFrom &= ~0b11; // align to 4 bytes
+    break;
+  case Op::SH:
+  case Op::LH:
+  case Op::LHU:
+    if (vAddr % 4 == 3) {
+      fetchFrom -= 2;
+    } else {
+      fetchFrom &= ~0b11;
+    }
+    break;
+  default:
+    break;
+  }
+  return fetchFrom;
+}
+
 } // namespace
 
-void Interpreter::simulate(const std::shared_ptr<inst::Instruction> &inst) {
+template <bool KeepDebugInfo, bool CacheEnabled, bool Guarded>
+void Interpreter::simulate(const DecodedInst &inst) {
   // Do NOT use dynamic cast. It is too time-consuming
   using Op = inst::Instruction::OpType;
-  auto op = inst->getOp();
+  auto op = (Op)inst.op;
 
   // has been moved to Interpreter::interpret()
   // struct Raii {
@@ -42,21 +79,9 @@ void Interpreter::simulate(const std::shared_ptr<inst::Instruction> &inst) {
       isArithRegImm =
           inst::Instruction::ADDI <= op && op <= inst::Instruction::SRAI;
       isArithRegReg || isArithRegImm) {
-    ++instCnt.simple;
-    std::uint32_t rs1, rs2;
-    std::size_t destNumber;
-    if (isArithRegReg) {
-      auto &p = spc<inst::ArithRegReg>(inst);
-      destNumber = p.getDest();
-      rs1 = regs[p.getSrc1()];
-      rs2 = regs[p.getSrc2()];
-    } else {
-      auto &p = spc<inst::ArithRegImm>(inst);
-      destNumber = p.getDest();
-      rs1 = regs[p.getSrc()];
-      rs2 = p.getImm();
-    }
-    auto &dest = regs[destNumber];
+    std::uint32_t rs1 = regs[inst.rs1];
+    std::uint32_t rs2 = isArithRegReg ? regs[inst.rs2] : inst.imm;
+    auto &dest = regs[inst.rd];
 
     switch (op) {
     case Op::ADD:
@@ -105,9 +130,8 @@ void Interpreter::simulate(const std::shared_ptr<inst::Instruction> &inst) {
 
   // MemAccess
   if (Op::LB <= op && op <= Op::SW) {
-    auto &p = spc<inst::MemAccess>(inst);
-    std::size_t vAddr = regs[p.getBase()] + p.getOffset();
-    if (keepDebugInfo && (isIn(invalidAddress, vAddr) || vAddr == 0)) {
+    std::size_t vAddr = regs[inst.rs1] + inst.imm;
+    if (KeepDebugInfo && (shadow.isPoisoned(vAddr) || vAddr == 0)) {
       // Accessing 0x0 is always invalid since an instruction is stored there.
       // Perform this check since many students use 0x0 as the actual value of
       // null.
@@ -115,56 +139,33 @@ void Interpreter::simulate(const std::shared_ptr<inst::Instruction> &inst) {
     }
 
     std::byte *addr = cache.getMemory().first + vAddr;
-    assert(addr < cache.getMemory().second);
-    // To avoid memory access error when accessing with byte or half-word, we
-    // need to change the address to a proper one.
-    // For example, we need to access a memory at one byte below the stack
-    // pointer, we cannot fetch a word from the address, since will cause a
-    // memory access error. Instead, we need to fetch a word from the address
-    // 4 bytes below the stack pointer, and then extract the byte we need.
-    std::size_t fetchFrom = vAddr;
+    assert(Guarded || addr < cache.getMemory().second);
+    std::size_t fetchFrom = getFetchAddress(op, vAddr);
+    cache.fetchWord<CacheEnabled, !Guarded>(fetchFrom);
     switch (op) {
     case Op::SB:
-    case Op::LB:
-    case Op::LBU:
-      fetchFrom &= ~0b11; // align to 4 bytes
-      break;
-    case Op::SH:
-    case Op::LH:
-    case Op::LHU:
-      if (vAddr % 4 == 3) {
-        fetchFrom -= 2;
-      } else {
-        fetchFrom &= ~0b11;
-      }
-      break;
-    }
-    cache.fetchWord(fetchFrom);
-    std::tie(instCnt.cache, instCnt.mem) = cache.getHitMiss();
-    switch (op) {
-    case Op::SB:
-      *(std::uint8_t *)addr = regs[p.getReg()];
+      *(std::uint8_t *)addr = regs[inst.rs2];
       return;
     case Op::SH:
-      *(std::uint16_t *)addr = regs[p.getReg()];
+      *(std::uint16_t *)addr = regs[inst.rs2];
       return;
     case Op::SW:
-      *(std::uint32_t *)addr = regs[p.getReg()];
+      *(std::uint32_t *)addr = regs[inst.rs2];
       return;
     case Op::LB:
-      regs[p.getReg()] = *(std::int8_t *)addr;
+      regs[inst.rd] = *(std::int8_t *)addr;
       return;
     case Op::LH:
-      regs[p.getReg()] = *(std::int16_t *)addr;
+      regs[inst.rd] = *(std::int16_t *)addr;
       return;
     case Op::LW:
-      regs[p.getReg()] = *(std::int32_t *)addr;
+      regs[inst.rd] = *(std::int32_t *)addr;
       return;
     case Op::LBU:
-      (std::uint32_t &)regs[p.getReg()] = *(std::uint8_t *)addr;
+      (std::uint32_t &)regs[inst.rd] = *(std::uint8_t *)addr;
       return;
     case Op::LHU:
-      (std::uint32_t &)regs[p.getReg()] = *(std::uint16_t *)addr;
+      (std::uint32_t &)regs[inst.rd] = *(std::uint16_t *)addr;
       return;
     default:
       assert(false);
@@ -172,12 +173,10 @@ void Interpreter::simulate(const std::shared_ptr<inst::Instruction> &inst) {
   }
 
   if (Op::BEQ <= op && op <= Op::BGEU) {
-    ++instCnt.br;
-    auto &p = spc<inst::Branch>(inst);
-    std::int32_t rs1 = regs[p.getSrc1()];
-    std::int32_t rs2 = regs[p.getSrc2()];
-    bool shouldJump;
-    switch (inst->getOp()) {
+    std::int32_t rs1 = regs[inst.rs1];
+    std::int32_t rs2 = regs[inst.rs2];
+    bool shouldJump = false;
+    switch (op) {
     case Op::BEQ:
       shouldJump = rs1 == rs2;
       break;
@@ -199,22 +198,16 @@ void Interpreter::simulate(const std::shared_ptr<inst::Instruction> &inst) {
     default:
       assert(false);
     }
+    predictBranch(pc, shouldJump);
     if (shouldJump)
-      pc += p.getOffset() - 4;
+      pc += inst.imm - 4;
     return;
   }
 
   if (Op::MUL <= op && op <= Op::REMU) {
-    if (Op::MUL <= op && op <= Op::MULHU)
-      ++instCnt.mul;
-    else
-      ++instCnt.div;
-
-    auto &p = spc<inst::MArith>(inst);
-    auto destNumber = p.getDest();
-    auto &dest = regs[destNumber];
-    std::uint32_t rs1 = regs[p.getSrc1()];
-    std::uint32_t rs2 = regs[p.getSrc2()];
+    auto &dest = regs[inst.rd];
+    std::uint32_t rs1 = regs[inst.rs1];
+    std::uint32_t rs2 = regs[inst.rs2];
     switch (op) {
     case Op::MUL:
       dest = (std::int32_t)rs1 * (std::int32_t)rs2;
@@ -254,47 +247,87 @@ void Interpreter::simulate(const std::shared_ptr<inst::Instruction> &inst) {
   }
 
   switch (op) {
-  case inst::Instruction::LUI: {
-    ++instCnt.simple;
-    auto &p = spc<inst::ImmConstruction>(inst);
-    regs[p.getDest()] = p.getImm() << 12u;
+  case inst::Instruction::LUI:
+    regs[inst.rd] = inst.imm;
     return;
-  }
 
-  case inst::ImmConstruction::AUIPC: {
-    ++instCnt.simple;
-    auto &p = spc<inst::ImmConstruction>(inst);
-    std::int32_t offset = (std::uint32_t)p.getImm() << 12u;
-    regs[p.getDest()] = pc + offset;
+  case inst::ImmConstruction::AUIPC:
+    regs[inst.rd] = pc + inst.imm;
     return;
-  }
 
   case Op::JAL: {
-    ++instCnt.simple;
-    auto &p = spc<inst::JumpLink>(inst);
-    auto offset = p.getOffset() * 2;
-    regs[p.getDest()] = pc + 4;
-    pc += offset - 4;
+    regs[inst.rd] = pc + 4;
+    pc += inst.imm - 4;
     return;
   }
 
   case Op::JALR: {
-    ++instCnt.simple;
-    auto &p = spc<inst::JumpLinkReg>(inst);
-    regs[p.getDest()] = pc + 4;
-    auto addr = regs[p.getBase()] + p.getOffset();
+    regs[inst.rd] = pc + 4;
+    auto addr = regs[inst.rs1] + inst.imm;
     addr &= ~1u;
+    predictJump(pc, addr);
     pc = addr - 4;
     return;
   }
 
   default:
-    assert(false);
+    // not an instruction
+    throw InvalidAddress(pc);
   }
 
   assert(false);
 }
 
+void Interpreter::count(const DecodedInst &inst) {
+  switch (getInstClass(inst)) {
+  case InstClass::Simple:
+    ++instCnt.simple;
+    break;
+  case InstClass::Mul:
+    ++instCnt.mul;
+    break;
+  case InstClass::Div:
+    ++instCnt.div;
+    break;
+  case InstClass::Branch:
+    ++instCnt.br;
+    break;
+  case InstClass::MemAccess:
+    break; // counted by the cache
+  }
+}
+
+template <bool CacheEnabled, bool Guarded>
+void Interpreter::simulate(const BasicBlock &block) {
+  instCnt.simple += block.simple;
+  instCnt.mul += block.mul;
+  instCnt.br += block.br;
+  instCnt.div += block.div;
+  if (icache)
+    icache->fetch(block.entry, block.insts.size());
+
+  // The cache needs to be ticked once per instruction before the instruction
+  // is executed, but only memory accesses can observe it.
+  std::size_t ticked = 0;
+  for (std::size_t i = 0; i < block.insts.size(); ++i) {
+    const auto &inst = block.insts[i];
+    if (inst::Instruction::LB <= inst.op && inst.op <= inst::Instruction::SW) {
+      cache.tick(i + 1 - ticked);
+      ticked = i + 1;
+    }
+    if (tracer)
+      traceBefore(inst);
+    simulate<false, CacheEnabled, Guarded>(inst);
+    if (tracer)
+      traceAfter(inst);
+    stepPipeline(inst);
+    pc += 4;
+  }
+  cache.tick(block.insts.size() - ticked);
+  // Only the last instruction of a block can write to x0.
+  regs[0] = 0;
+}
+
 std::uint32_t Interpreter::getReturnCode() const {
   return 0xffffu & regs.at(regName2regNumber("a0"));
 }
@@ -302,12 +335,28 @@ std::uint32_t Interpreter::getReturnCode() const {
 void Interpreter::load() {
   std::copy(interpretable.getStorage().begin(),
             interpretable.getStorage().end(), cache.getMemory().first);
-  heapPtr = interpretable.getStorage().size();
-  assert(heapPtr < cache.storageSize() / 2);
+  decodedInsts = decode(interpretable);
+  blockCache.emplace(decodedInsts);
+  if (annotate)
+    annotator.emplace(interpretable, decodedInsts, *blockCache);
+  if (branchPredictorConfig)
+    branchPredictor.emplace(*branchPredictorConfig, decodedInsts.size());
+  heap.reset(interpretable.getStorage().size());
+  assert(heap.getTop() < cache.storageSize() / 2);
   pc = Interpretable::Start;
   regs.at(regName2regNumber("sp")) = cache.storageSize();
 }
 
+// used by the threaded interpreter and the JIT
+template void Interpreter::simulate<false, false, false>(const DecodedInst &);
+template void Interpreter::simulate<false, false, true>(const DecodedInst &);
+template void Interpreter::simulate<false, true, false>(const DecodedInst &);
+template void Interpreter::simulate<false, true, true>(const DecodedInst &);
+template void Interpreter::simulate<false, false>(const BasicBlock &);
+template void Interpreter::simulate<false, true>(const BasicBlock &);
+template void Interpreter::simulate<true, false>(const BasicBlock &);
+template void Interpreter::simulate<true, true>(const BasicBlock &);
+
 namespace {
 struct DebugStackFrame {
   void addInstruction(std::shared_ptr<inst::Instruction> inst) {
@@ -319,6 +368,9 @@ struct DebugStackFrame {
   static constexpr std::size_t MaxSize = 8;
   std::queue<std::shared_ptr<inst::Instruction>> lastFewInstructions;
 };
+
+// stands in for the debug stack if no debug info is kept
+struct NoDebugStack {};
 } // namespace
 
 namespace {
@@ -355,34 +407,155 @@ getModifiedReg(const std::shared_ptr<inst::Instruction> &inst) {
 
 void Interpreter::interpret() {
   load();
+  if (decoupledTiming && !needsBasicEngine())
+    interpretDecoupled();
+  else
+    runEngine();
+}
+
+void Interpreter::interpretDecoupled() {
+  TraceRing ring;
+  timingCache = std::make_unique<Cache>(cache);
+  cache.forwardTo(&ring);
+  std::thread timing([this, &ring] {
+    ring.consume(
+        [this](const TraceEvent &event) { timingCache->replay(event); });
+  });
+  {
+    std::shared_ptr<void> stop(nullptr, [this, &ring, &timing](void *) {
+      ring.close();
+      timing.join();
+      cache.forwardTo(nullptr);
+    });
+    runEngine();
+  }
+  countCacheAccesses();
+}
+
+void Interpreter::runEngine() {
+  bool cacheEnabled = cache.isEnabled();
+  if (!printInstructions && !keepDebugInfo) {
+    if (jit && JitCompiler::isSupported() && !needsBasicEngine()) {
+      cacheEnabled ? interpretJit<true>() : interpretJit<false>();
+      return;
+    }
+    if (guardPages) {
+      if (threadedDispatch && !needsBasicEngine()) {
+        cacheEnabled ? interpretThreaded<true, true>()
+                     : interpretThreaded<false, true>();
+        return;
+      }
+      interpretGuarded(
+          [](void *context) {
+            auto self = (Interpreter *)context;
+            self->cache.isEnabled()
+                ? self->interpretImpl<false, false, true, true>()
+                : self->interpretImpl<false, false, false, true>();
+          },
+          this);
+      return;
+    }
+    if (threadedDispatch && !needsBasicEngine()) {
+      cacheEnabled ? interpretThreaded<true, false>()
+                   : interpretThreaded<false, false>();
+      return;
+    }
+    cacheEnabled ? interpretImpl<false, false, true, false>()
+                 : interpretImpl<false, false, false, false>();
+    return;
+  }
+  if (keepDebugInfo) {
+    if (printInstructions)
+      cacheEnabled ? interpretImpl<true, true, true, false>()
+                   : interpretImpl<true, true, false, false>();
+    else
+      cacheEnabled ? interpretImpl<false, true, true, false>()
+                   : interpretImpl<false, true, false, false>();
+    return;
+  }
+  cacheEnabled ? interpretImpl<true, false, true, false>()
+               : interpretImpl<true, false, false, false>();
+}
+
+void Interpreter::interpretGuarded(void (*engine)(void *), void *context) {
+  auto faultAddr = runGuarded(engine, context);
+  if (!faultAddr)
+    return;
+  std::size_t faultVAddr = *faultAddr - cache.getMemory().first;
+  // `pc` is the address of the faulting instruction (cf. interpretImpl() and
+  // runThreaded()), which has not modified any register. If the fault is in
+  // its access, report the same address as Cache::fetchWord() would have.
+  if (0 <= pc && (std::uint32_t)pc < decodedInsts.size() * 4 && pc % 4 == 0) {
+    const auto &inst = decodedInsts[pc / 4];
+    std::size_t vAddr = regs[inst.rs1] + inst.imm;
+    if (inst::Instruction::LB <= inst.op && inst.op <= inst::Instruction::SW &&
+        vAddr <= faultVAddr && faultVAddr < vAddr + 4) {
+      auto op = (inst::Instruction::OpType)inst.op;
+      throw InvalidAddress(getFetchAddress(op, vAddr), pc);
+    }
+  }
+  throw InvalidAddress(faultVAddr, pc);
+}
+
+template <bool PrintInstructions, bool KeepDebugInfo, bool CacheEnabled,
+          bool Guarded>
+void Interpreter::interpretImpl() {
+  assert(PrintInstructions == printInstructions &&
+         KeepDebugInfo == keepDebugInfo && CacheEnabled == cache.isEnabled());
   std::size_t numInsts = 0;
 
-  std::stack<DebugStackFrame> debugStack;
-  debugStack.emplace();
+  // Only kept with debug info, so that the loop owns nothing otherwise, as
+  // required by runGuarded()
+  std::conditional_t<KeepDebugInfo, std::stack<DebugStackFrame>, NoDebugStack>
+      debugStack;
+  if constexpr (KeepDebugInfo)
+    debugStack.emplace();
 
   try {
     while (pc != Interpretable::End) {
-      if (!(0 <= pc && (std::uint32_t)pc < cache.storageSize())) {
+      if (!(0 <= pc && (std::uint32_t)pc < decodedInsts.size() * 4)) {
         throw InvalidAddress(pc);
       }
+      if (!(KeepDebugInfo || PrintInstructions) && pc % 4 == 0) {
+        // Run a whole basic block at once unless the timeout may be reached
+        // in it, in which case it is interpreted instruction by instruction.
+        auto block = blockCache->get(pc);
+        if (block && numInsts + block->insts.size() <= timeout) {
+          numInsts += block->insts.size();
+          profile();
+          if (annotator)
+            annotator->enterBlock(pc, getProfilerCounters());
+          simulate<CacheEnabled, Guarded>(*block);
+          traceCall(block->insts.back());
+          continue;
+        }
+      }
       ++numInsts;
       if (numInsts > timeout) {
         throw Timeout("");
       }
+      profile();
+      if (annotator)
+        annotator->enterInst(pc, getProfilerCounters());
       cache.tick();
       if (Interpretable::LibcFuncStart <= (std::uint32_t)pc &&
           (std::uint32_t)pc < Interpretable::LibcFuncEnd) {
-        if (printInstructions) {
+        if (PrintInstructions) {
           std::cerr << "call libc-" << pc << std::endl;
         }
-        if (keepDebugInfo) {
+        if constexpr (KeepDebugInfo)
           debugStack.pop();
-        }
+        if (tracer)
+          tracer->begin(pc);
         simulateLibCFunc(libc::Func(pc));
-        if (printInstructions) {
+        if (tracer)
+          tracer->regWrite(10, regs[10]);
+        if (PrintInstructions) {
           std::cerr << "\t\t# return value = " << regs.at(10) << std::endl;
         }
         pc = regs[1];
+        if (profiler && profiler->hasCallGraph())
+          profiler->ret(getProfilerCounters());
         // force the calling convention
         int callerSaved[] = {1,  5,  6,  7,  /* 10, */ 11, 12, 13, 14,
                              15, 16, 17, 28, 29,           30, 31};
@@ -391,12 +564,33 @@ void Interpreter::interpret() {
         continue;
       }
 
+      // The IF stage only accesses the I-cache, if any
+      if (pc % 4 != 0)
+        throw InvalidAddress(pc);
+      const auto &decoded = decodedInsts[pc / 4];
+      if (icache && decoded.op != DecodedInst::Invalid)
+        icache->fetch(pc);
+      if (tracer && decoded.op != DecodedInst::Invalid)
+        traceBefore(decoded);
+      if (!(KeepDebugInfo || PrintInstructions)) {
+        simulate<KeepDebugInfo, CacheEnabled, Guarded>(decoded);
+        if (tracer)
+          traceAfter(decoded);
+        stepPipeline(decoded);
+        count(decoded);
+        regs[0] = 0;
+        pc += 4;
+        traceCall(decoded);
+        continue;
+      }
+
+      // slow path: the original instruction is needed for the debug info
+      if (decoded.op == DecodedInst::Invalid)
+        throw InvalidAddress(pc);
       auto instIdx = *(std::uint32_t *)(cache.getMemory().first + pc);
-      // We no longer take the mem/cache access in the IF stage into
-      // consideration
       const auto &inst = interpretable.getInsts().at(instIdx);
 
-      if (keepDebugInfo) {
+      if constexpr (KeepDebugInfo) {
         debugStack.top().addInstruction(inst);
         if (inst->getOp() == inst::Instruction::JALR) {
           // ret -> jalr x0, x1, 0
@@ -410,7 +604,7 @@ void Interpreter::interpret() {
       }
       std::size_t modifiedReg = -1;
       std::uint64_t oldVal = -1;
-      if (printInstructions) {
+      if (PrintInstructions) {
         printInstWithComment(inst);
         if (auto opt = getModifiedReg(inst)) {
           modifiedReg = opt.value();
@@ -418,9 +612,13 @@ void Interpreter::interpret() {
         }
       }
 
-      simulate(inst);
+      simulate<KeepDebugInfo, CacheEnabled, Guarded>(decoded);
+      if (tracer)
+        traceAfter(decoded);
+      stepPipeline(decoded);
+      count(decoded);
 
-      if (printInstructions) {
+      if (PrintInstructions) {
         if (modifiedReg != -1) {
           std::cerr << "\t\t# " << regNumber2regName(modifiedReg) << ": "
                     << oldVal << " -> " << regs.at(modifiedReg) << std::endl;
@@ -433,37 +631,45 @@ void Interpreter::interpret() {
 
       regs[0] = 0;
       pc += 4;
+      traceCall(decoded);
     }
+    if (profiler)
+      profiler->finish(getProfilerCounters());
+    if (annotator)
+      annotator->finish(getProfilerCounters());
+    countCacheAccesses();
   } catch (std::exception &e) {
-    if (!keepDebugInfo)
-      throw;
-    std::cerr << "\nSome error occurred.\n";
-    std::cerr << "Printing the register state...";
-    for (std::size_t i = 0; i < 32; ++i) {
-      if (i % 8 == 0)
-        std::cerr << "\n";
-      std::cerr << std::setw(4) << regNumber2regName(i) << " = "
-                << std::setw(11) << regs.at(i) << ",\t";
-    }
-    std::cerr << "\n\nPrinting the call stack...\n";
-    while (!debugStack.empty()) {
-      auto &frame = debugStack.top().lastFewInstructions;
-      std::cerr << "\t...\n";
-      while (!frame.empty()) {
-        std::cerr << "\t";
-        printInstWithComment(frame.front());
-        frame.pop();
+    if constexpr (KeepDebugInfo) {
+      std::cerr << "\nSome error occurred.\n";
+      std::cerr << "Printing the register state...";
+      for (std::size_t i = 0; i < 32; ++i) {
+        if (i % 8 == 0)
+          std::cerr << "\n";
+        std::cerr << std::setw(4) << regNumber2regName(i) << " = "
+                  << std::setw(11) << regs.at(i) << ",\t";
+      }
+      std::cerr << "\n\nPrinting the call stack...\n";
+      while (!debugStack.empty()) {
+        auto &frame = debugStack.top().lastFewInstructions;
+        std::cerr << "\t...\n";
+        while (!frame.empty()) {
+          std::cerr << "\t";
+          printInstWithComment(frame.front());
+          frame.pop();
+        }
+        debugStack.pop();
+        if (!debugStack.empty())
+          std::cerr << "from ...\n";
       }
-      debugStack.pop();
-      if (!debugStack.empty())
-        std::cerr << "from ...\n";
+      std::cerr << std::endl;
     }
-    std::cerr << std::endl;
     throw;
   }
 }
 
 void Interpreter::simulateLibCFunc(libc::Func funcN) {
+  // The functions own resources, so they must not be abandoned on a fault
+  UnguardedScope unguarded;
   if (libc::PUTS <= funcN && funcN <= libc::PUTCHAR)
     ++instCnt.libcIO;
   else if (libc::MALLOC <= funcN && funcN <= libc::CALLOC) {
@@ -493,14 +699,14 @@ void Interpreter::simulateLibCFunc(libc::Func funcN) {
     return;
   case libc::MALLOC:
     libc::malloc(regs, cache.getMemory().first, cache.getMemory().second,
-                 heapPtr, malloced, invalidAddress, instCnt.libcMem);
+                 heap, shadow, instCnt.libcMem);
     return;
   case libc::CALLOC:
     libc::malloc(regs, cache.getMemory().first, cache.getMemory().second,
-                 heapPtr, malloced, invalidAddress, instCnt.libcMem, true);
+                 heap, shadow, instCnt.libcMem, true);
     return;
   case libc::FREE:
-    libc::free(regs, malloced);
+    libc::free(regs, heap, shadow);
     return;
   case libc::MEMCPY:
     libc::memcpy(regs, cache.getMemory().first, cache.getMemory().second,
@@ -530,4 +736,114 @@ void Interpreter::simulateLibCFunc(libc::Func funcN) {
   assert(false);
 }
 
+void Interpreter::countCacheAccesses() {
+  // counted once the timing thread has finished, cf. interpretDecoupled()
+  if (cache.isForwarding())
+    return;
+  const auto &cache = getTimingCache();
+  std::tie(instCnt.cache, instCnt.mem) = cache.getHitMiss();
+  instCnt.lowerCache = getLowerCacheHits(cache);
+  if (icache)
+    std::tie(instCnt.icache, instCnt.imem) = icache->getHitMiss();
+}
+
+Profiler::Counters Interpreter::getProfilerCounters() const {
+  Profiler::Counters counters;
+  counters.simple = instCnt.simple;
+  counters.mul = instCnt.mul;
+  std::tie(counters.cache, counters.mem) = cache.getHitMiss();
+  counters.br = instCnt.br;
+  counters.div = instCnt.div;
+  counters.libcIO = instCnt.libcIO;
+  counters.libcMem = instCnt.libcMem;
+  if (icache)
+    std::tie(counters.icache, counters.imem) = icache->getHitMiss();
+  counters.brMiss = instCnt.brMiss;
+  const auto &levels = cache.getLevels();
+  for (std::size_t i = 1; cache.isEnabled() && i < levels.size(); ++i)
+    counters.lowerCacheTime +=
+        levels[i].getHitMiss().first * levels[i].getConfig().latency;
+  return counters;
+}
+
+std::size_t
+Interpreter::getTimeConsumed(const Profiler::Counters &counters) const {
+  return counters.simple * instWeight.simple +
+         counters.mul * instWeight.mul + counters.cache * instWeight.cache +
+         counters.br * instWeight.br + counters.div * instWeight.div +
+         counters.mem * instWeight.mem +
+         counters.libcIO * instWeight.libcIO +
+         counters.libcMem * instWeight.libcMem +
+         counters.icache * instWeight.icache +
+         counters.imem * instWeight.imem +
+         counters.brMiss * instWeight.brMiss + counters.lowerCacheTime;
+}
+
+void Interpreter::printAnnotation(std::ostream &os) const {
+  auto instCost = [this](const DecodedInst &inst) -> std::size_t {
+    switch (getInstClass(inst)) {
+    case InstClass::Simple:
+      return instWeight.simple;
+    case InstClass::Mul:
+      return instWeight.mul;
+    case InstClass::Div:
+      return instWeight.div;
+    case InstClass::Branch:
+      return instWeight.br;
+    case InstClass::MemAccess:
+      return 0; // counted by the cache
+    }
+    return 0;
+  };
+  auto time = [this](const Profiler::Counters &counters) {
+    return getTimeConsumed(counters);
+  };
+  annotator->print(os, instCost, time, getTimeConsumed());
+}
+
+std::vector<std::size_t> Interpreter::getLowerCacheHits(const Cache &cache) {
+  std::vector<std::size_t> hits;
+  for (std::size_t i = 1; cache.isEnabled() && i < cache.getLevels().size();
+       ++i)
+    hits.emplace_back(cache.getLevels()[i].getHitMiss().first);
+  return hits;
+}
+
+std::size_t Interpreter::computeTime(const InstCnt &instCnt,
+                                     const InstWeight &instWeight,
+                                     const Cache &cache) {
+  auto time =
+      instCnt.simple * instWeight.simple + instCnt.mul * instWeight.mul +
+      instCnt.cache * instWeight.cache + instCnt.br * instWeight.br +
+      instCnt.div * instWeight.div + instCnt.mem * instWeight.mem +
+      instCnt.libcIO * instWeight.libcIO +
+      instCnt.libcMem * instWeight.libcMem +
+      instCnt.icache * instWeight.icache + instCnt.imem * instWeight.imem +
+      instCnt.brMiss * instWeight.brMiss;
+  for (std::size_t i = 0; i < instCnt.lowerCache.size(); ++i)
+    time += instCnt.lowerCache[i] *
+            cache.getLevels()[i + 1].getConfig().latency;
+  return time;
+}
+
+void Interpreter::addCostModel(const CostModel &model) {
+  auto [storageBegin, storageEnd] = cache.getMemory();
+  auto modelCache = std::make_unique<Cache>(storageBegin, storageEnd);
+  modelCache->configure(model.cacheLevels, model.cacheInclusion);
+  if (model.prefetcher)
+    modelCache->setPrefetcher(*model.prefetcher);
+  if (!model.cacheEnabled)
+    modelCache->disable();
+  cache.addFollower(modelCache.get());
+  costModels.emplace_back(model, std::move(modelCache));
+}
+
+std::size_t Interpreter::getTimeConsumed(std::size_t i) const {
+  const auto &[model, modelCache] = costModels.at(i);
+  auto cnt = instCnt;
+  std::tie(cnt.cache, cnt.mem) = modelCache->getHitMiss();
+  cnt.lowerCache = getLowerCacheHits(*modelCache);
+  return computeTime(cnt, model.instWeight, *modelCache);
+}
+
 } // namespace ravel
@@ -0,0 +1,602 @@
+#include "ravel/interpreter/jit.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <optional>
+
+#include "ravel/error.h"
+#include "ravel/interpreter/interpreter.h"
+
+#ifdef RAVEL_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// The JIT does no register allocation: the guest registers stay in memory and
+// every instruction is translated on its own into loads of its operands into
+// host registers, the operation and a store of the result. Even so, this
+// removes the decoding and dispatching of the interpreters entirely.
+//
+// Register usage of the translated code:
+//   rbx: the guest registers
+//   r12: the guest memory
+//   r13: the `JitCompiler::Context`
+//   r14: the address of the current memory access
+//   eax, ecx, edx, esi: scratch
+
+namespace ravel {
+namespace {
+
+bool isBranchTaken(const DecodedInst &inst, const std::uint32_t *regs) {
+  using Op = inst::Instruction::OpType;
+  std::int32_t rs1 = regs[inst.rs1];
+  std::int32_t rs2 = regs[inst.rs2];
+  switch (inst.op) {
+  case Op::BEQ:
+    return rs1 == rs2;
+  case Op::BNE:
+    return rs1 != rs2;
+  case Op::BLT:
+    return rs1 < rs2;
+  case Op::BGE:
+    return rs1 >= rs2;
+  case Op::BLTU:
+    return (std::uint32_t)rs1 < (std::uint32_t)rs2;
+  case Op::BGEU:
+    return (std::uint32_t)rs1 >= (std::uint32_t)rs2;
+  default:
+    assert(false);
+    return false;
+  }
+}
+
+#ifdef RAVEL_JIT
+
+// Called by the translated code before every memory access.
+template <bool CacheEnabled>
+bool accessMemory(JitCompiler::Context *ctx, std::size_t fetchFrom,
+                  std::size_t ticks) {
+  ctx->cache->tick(ticks);
+  // Cache::fetchWord() would throw, which must not happen in translated code
+  if (fetchFrom + 4 > ctx->cache->storageSize()) {
+    ctx->fault = true;
+    ctx->faultAddr = fetchFrom;
+    return false;
+  }
+  ctx->cache->fetchWord<CacheEnabled>(fetchFrom);
+  return true;
+}
+
+enum HostReg : std::uint8_t { EAX = 0, ECX = 1, EDX = 2, ESI = 6 };
+
+class Emitter {
+public:
+  void emit(std::initializer_list<std::uint8_t> bytes) {
+    code.insert(code.end(), bytes);
+  }
+
+  void emitImm32(std::uint32_t imm) {
+    for (int i = 0; i < 4; ++i)
+      code.emplace_back((std::uint8_t)(imm >> (8 * i)));
+  }
+
+  void emitImm64(std::uint64_t imm) {
+    emitImm32((std::uint32_t)imm);
+    emitImm32((std::uint32_t)(imm >> 32u));
+  }
+
+  // mov reg, [rbx + 4 * guestReg]
+  void loadReg(HostReg reg, std::uint8_t guestReg) {
+    emit({0x8b, (std::uint8_t)(0x43 | reg << 3u),
+          (std::uint8_t)(4 * guestReg)});
+  }
+
+  // mov [rbx + 4 * guestReg], eax
+  void storeReg(std::uint8_t guestReg) {
+    emit({0x89, 0x43, (std::uint8_t)(4 * guestReg)});
+  }
+
+  // mov dword [rbx + 4 * guestReg], imm
+  void storeImm(std::uint8_t guestReg, std::uint32_t imm) {
+    emit({0xc7, 0x43, (std::uint8_t)(4 * guestReg)});
+    emitImm32(imm);
+  }
+
+  // mov reg, imm
+  void movImm(HostReg reg, std::uint32_t imm) {
+    emit({(std::uint8_t)(0xb8 + reg)});
+    emitImm32(imm);
+  }
+
+  // jmp or jcc (if `cond` is given) to the epilogue
+  void jumpToEpilogue(std::optional<std::uint8_t> cond = std::nullopt) {
+    if (cond)
+      emit({0x0f, *cond});
+    else
+      emit({0xe9});
+    fixups.emplace_back(code.size());
+    emitImm32(0);
+  }
+
+  // Return `nextPc` from the translated block. The last instruction of a
+  // block may write to x0, so reset it here.
+  void exitBlock(std::uint32_t nextPc) {
+    emit({0xc7, 0x03});
+    emitImm32(0);
+    movImm(EAX, nextPc);
+    jumpToEpilogue();
+  }
+
+  void prologue() {
+    emit({0x53});                   // push rbx
+    emit({0x41, 0x54});             // push r12
+    emit({0x41, 0x55});             // push r13
+    emit({0x41, 0x56});             // push r14
+    emit({0x48, 0x83, 0xec, 0x08}); // sub rsp, 8
+    emit({0x49, 0x89, 0xfd});       // mov r13, rdi
+    // mov rbx, [rdi + regs]
+    emit({0x48, 0x8b, 0x5f,
+          (std::uint8_t)offsetof(JitCompiler::Context, regs)});
+    // mov r12, [rdi + memory]
+    emit({0x4c, 0x8b, 0x67,
+          (std::uint8_t)offsetof(JitCompiler::Context, memory)});
+  }
+
+  void epilogue() {
+    for (auto pos : fixups) {
+      std::uint32_t rel = code.size() - (pos + 4);
+      std::memcpy(code.data() + pos, &rel, 4);
+    }
+    emit({0x48, 0x83, 0xc4, 0x08}); // add rsp, 8
+    emit({0x41, 0x5e});             // pop r14
+    emit({0x41, 0x5d});             // pop r13
+    emit({0x41, 0x5c});             // pop r12
+    emit({0x5b});                   // pop rbx
+    emit({0xc3});                   // ret
+  }
+
+  const std::vector<std::uint8_t> &getCode() const { return code; }
+
+private:
+  std::vector<std::uint8_t> code;
+  std::vector<std::size_t> fixups;
+};
+
+using AccessMemoryFunc = bool (*)(JitCompiler::Context *, std::size_t,
+                                  std::size_t);
+
+// Translate a memory access. `ticks` cache ticks are due before it.
+void translateMemAccess(Emitter &e, const DecodedInst &inst, std::size_t ticks,
+                        AccessMemoryFunc accessMemory) {
+  using Op = inst::Instruction::OpType;
+  auto op = (Op)inst.op;
+
+  // r14 = vAddr = regs[rs1] + imm; esi = fetchFrom, cf. Interpreter::simulate()
+  e.loadReg(ESI, inst.rs1);
+  e.emit({0x81, 0xc6}); // add esi, imm
+  e.emitImm32(inst.imm);
+  e.emit({0x41, 0x89, 0xf6}); // mov r14d, esi
+  switch (op) {
+  case Op::SB:
+  case Op::LB:
+  case Op::LBU:
+    e.emit({0x83, 0xe6, 0xfc}); // and esi, ~3
+    break;
+  case Op::SH:
+  case Op::LH:
+  case Op::LHU:
+    // vAddr - 2 == (vAddr & ~3) + 1 if vAddr % 4 == 3
+    e.emit({0x83, 0xe6, 0xfc}); // and esi, ~3
+    e.emit({0x44, 0x89, 0xf0}); // mov eax, r14d
+    e.emit({0x83, 0xe0, 0x03}); // and eax, 3
+    e.emit({0x83, 0xf8, 0x03}); // cmp eax, 3
+    e.emit({0x75, 0x02});       // jne +2
+    e.emit({0xff, 0xc6});       // inc esi
+    break;
+  default:
+    break;
+  }
+
+  e.emit({0x4c, 0x89, 0xef}); // mov rdi, r13
+  e.movImm(EDX, ticks);
+  e.emit({0x48, 0xb8}); // mov rax, accessMemory
+  e.emitImm64((std::uint64_t)(std::uintptr_t)accessMemory);
+  e.emit({0xff, 0xd0}); // call rax
+  e.emit({0x84, 0xc0}); // test al, al
+  e.jumpToEpilogue(0x84);     // jz
+
+  // The operand is [r12 + r14].
+  switch (op) {
+  case Op::LB:
+    e.emit({0x43, 0x0f, 0xbe, 0x04, 0x34}); // movsx eax, byte
+    break;
+  case Op::LH:
+    e.emit({0x43, 0x0f, 0xbf, 0x04, 0x34}); // movsx eax, word
+    break;
+  case Op::LW:
+    e.emit({0x43, 0x8b, 0x04, 0x34}); // mov eax, dword
+    break;
+  case Op::LBU:
+    e.emit({0x43, 0x0f, 0xb6, 0x04, 0x34}); // movzx eax, byte
+    break;
+  case Op::LHU:
+    e.emit({0x43, 0x0f, 0xb7, 0x04, 0x34}); // movzx eax, word
+    break;
+  case Op::SB:
+    e.loadReg(EAX, inst.rs2);
+    e.emit({0x43, 0x88, 0x04, 0x34}); // mov byte, al
+    return;
+  case Op::SH:
+    e.loadReg(EAX, inst.rs2);
+    e.emit({0x66, 0x43, 0x89, 0x04, 0x34}); // mov word, ax
+    return;
+  case Op::SW:
+    e.loadReg(EAX, inst.rs2);
+    e.emit({0x43, 0x89, 0x04, 0x34}); // mov dword, eax
+    return;
+  default:
+    assert(false);
+  }
+  e.storeReg(inst.rd);
+}
+
+inst::Instruction::OpType toArithRegReg(inst::Instruction::OpType op) {
+  using Op = inst::Instruction::OpType;
+  switch (op) {
+  case Op::ADDI:
+    return Op::ADD;
+  case Op::SLTI:
+    return Op::SLT;
+  case Op::SLTIU:
+    return Op::SLTU;
+  case Op::XORI:
+    return Op::XOR;
+  case Op::ORI:
+    return Op::OR;
+  case Op::ANDI:
+    return Op::AND;
+  case Op::SLLI:
+    return Op::SLL;
+  case Op::SRLI:
+    return Op::SRL;
+  case Op::SRAI:
+    return Op::SRA;
+  default:
+    assert(false);
+    return op;
+  }
+}
+
+// Translate an instruction which neither transfers control nor accesses
+// memory. eax = rs1, ecx = rs2 or the immediate.
+void translateArith(Emitter &e, const DecodedInst &inst) {
+  using Op = inst::Instruction::OpType;
+  auto op = (Op)inst.op;
+
+  if (op == Op::LUI) {
+    e.movImm(EAX, inst.imm);
+    e.storeReg(inst.rd);
+    return;
+  }
+
+  e.loadReg(EAX, inst.rs1);
+  if (Op::ADDI <= op && op <= Op::SRAI) {
+    e.movImm(ECX, inst.imm);
+    op = toArithRegReg(op);
+  } else {
+    e.loadReg(ECX, inst.rs2);
+  }
+
+  switch (op) {
+  case Op::ADD:
+    e.emit({0x01, 0xc8});
+    break;
+  case Op::SUB:
+    e.emit({0x29, 0xc8});
+    break;
+  case Op::SLL:
+    e.emit({0xd3, 0xe0});
+    break;
+  case Op::SLT:
+    e.emit({0x39, 0xc8, 0x0f, 0x9c, 0xc0, 0x0f, 0xb6, 0xc0}); // setl
+    break;
+  case Op::SLTU:
+    e.emit({0x39, 0xc8, 0x0f, 0x92, 0xc0, 0x0f, 0xb6, 0xc0}); // setb
+    break;
+  case Op::XOR:
+    e.emit({0x31, 0xc8});
+    break;
+  case Op::SRL:
+    e.emit({0xd3, 0xe8});
+    break;
+  case Op::SRA:
+    e.emit({0xd3, 0xf8});
+    break;
+  case Op::OR:
+    e.emit({0x09, 0xc8});
+    break;
+  case Op::AND:
+    e.emit({0x21, 0xc8});
+    break;
+  case Op::MUL:
+    e.emit({0x0f, 0xaf, 0xc1}); // imul eax, ecx
+    break;
+  case Op::MULH:
+    e.emit({0xf7, 0xe9, 0x89, 0xd0}); // imul ecx; mov eax, edx
+    break;
+  case Op::MULHSU:
+    e.emit({0x48, 0x63, 0xc0});       // movsxd rax, eax
+    e.emit({0x48, 0x0f, 0xaf, 0xc1}); // imul rax, rcx
+    e.emit({0x48, 0xc1, 0xe8, 0x20}); // shr rax, 32
+    break;
+  case Op::MULHU:
+    e.emit({0xf7, 0xe1, 0x89, 0xd0}); // mul ecx; mov eax, edx
+    break;
+  case Op::DIV:
+    e.emit({0x99, 0xf7, 0xf9}); // cdq; idiv ecx
+    break;
+  case Op::DIVU:
+    e.emit({0x31, 0xd2, 0xf7, 0xf1}); // xor edx, edx; div ecx
+    break;
+  case Op::REM:
+    e.emit({0x99, 0xf7, 0xf9, 0x89, 0xd0});
+    break;
+  case Op::REMU:
+    e.emit({0x31, 0xd2, 0xf7, 0xf1, 0x89, 0xd0});
+    break;
+  default:
+    assert(false);
+  }
+  e.storeReg(inst.rd);
+}
+
+// Translate the last instruction of a block if it transfers control.
+void translateJump(Emitter &e, const DecodedInst &inst, std::uint32_t pc) {
+  using Op = inst::Instruction::OpType;
+  auto op = (Op)inst.op;
+
+  if (op == Op::JAL) {
+    e.storeImm(inst.rd, pc + 4);
+    e.exitBlock(pc + inst.imm);
+    return;
+  }
+  if (op == Op::JALR) {
+    // the same order as in `Interpreter::simulate()`
+    e.storeImm(inst.rd, pc + 4);
+    e.loadReg(EAX, inst.rs1);
+    e.emit({0x05}); // add eax, imm
+    e.emitImm32(inst.imm);
+    e.emit({0x25}); // and eax, ~1
+    e.emitImm32(~1u);
+    e.emit({0xc7, 0x03}); // mov dword [rbx], 0
+    e.emitImm32(0);
+    e.jumpToEpilogue();
+    return;
+  }
+
+  assert(Op::BEQ <= op && op <= Op::BGEU);
+  // cmovcc eax, edx
+  static constexpr std::uint8_t CmovOps[] = {0x44, 0x45, 0x4c,
+                                             0x4d, 0x42, 0x43};
+  e.loadReg(EAX, inst.rs1);
+  e.loadReg(ECX, inst.rs2);
+  e.emit({0x39, 0xc8}); // cmp eax, ecx
+  e.movImm(EAX, pc + 4);
+  e.movImm(EDX, pc + inst.imm);
+  e.emit({0x0f, CmovOps[op - Op::BEQ], 0xc2});
+  e.jumpToEpilogue();
+}
+
+#endif
+
+} // namespace
+
+JitCompiler::~JitCompiler() {
+#ifdef RAVEL_JIT
+  for (auto [begin, size] : chunks)
+    munmap(begin, size);
+#endif
+}
+
+bool JitCompiler::isSupported() {
+#ifdef RAVEL_JIT
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::byte *JitCompiler::allocate(std::size_t size) {
+#ifdef RAVEL_JIT
+  if (chunks.empty() || chunkUsed + size > chunks.back().second) {
+    auto chunkSize = std::max(ChunkSize, size);
+    void *p = mmap(nullptr, chunkSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      disable("mmap");
+      return nullptr;
+    }
+    chunks.emplace_back((std::byte *)p, chunkSize);
+    chunkUsed = 0;
+  }
+  auto res = chunks.back().first + chunkUsed;
+  chunkUsed += (size + 15) / 16 * 16;
+  return res;
+#else
+  (void)size;
+  return nullptr;
+#endif
+}
+
+bool JitCompiler::protect(std::byte *begin, std::size_t size, bool writable) {
+#ifdef RAVEL_JIT
+  static const auto pageSize = (std::uintptr_t)sysconf(_SC_PAGESIZE);
+  auto from = (std::uintptr_t)begin & ~(pageSize - 1);
+  auto to = (std::uintptr_t)begin + size;
+  auto prot = writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+  if (mprotect((void *)from, to - from, prot) == 0)
+    return true;
+  disable("mprotect");
+#else
+  (void)begin, (void)size, (void)writable;
+#endif
+  return false;
+}
+
+void JitCompiler::disable(const char *call) {
+  std::cerr << "JIT disabled: " << call << " failed (" << std::strerror(errno)
+            << "), interpreting instead" << std::endl;
+  disabled = true;
+}
+
+JitCompiler::JitBlock JitCompiler::compile(const BasicBlock &block) {
+#ifdef RAVEL_JIT
+  using Op = inst::Instruction::OpType;
+
+  if (disabled)
+    return {};
+
+  auto accessMemoryFunc =
+      cacheEnabled ? &accessMemory<true> : &accessMemory<false>;
+  Emitter e;
+  e.prologue();
+  std::size_t ticked = 0;
+  std::uint32_t pc = block.entry;
+  for (std::size_t i = 0; i < block.insts.size(); ++i, pc += 4) {
+    const auto &inst = block.insts[i];
+    auto op = (Op)inst.op;
+    if (Op::LB <= op && op <= Op::SW) {
+      translateMemAccess(e, inst, i + 1 - ticked, accessMemoryFunc);
+      ticked = i + 1;
+    } else if (Op::JAL <= op && op <= Op::BGEU) {
+      assert(i + 1 == block.insts.size());
+      translateJump(e, inst, pc);
+      break;
+    } else if (op == Op::AUIPC) {
+      e.movImm(EAX, pc + inst.imm);
+      e.storeReg(inst.rd);
+    } else {
+      translateArith(e, inst);
+    }
+    if (i + 1 == block.insts.size())
+      e.exitBlock(pc + 4);
+  }
+  e.epilogue();
+
+  const auto &code = e.getCode();
+  auto mem = allocate(code.size());
+  // The last page may hold the blocks translated before, which are not
+  // executable while it is writable.
+  if (!mem || !protect(mem, code.size(), true))
+    return {};
+  std::memcpy(mem, code.data(), code.size());
+  if (!protect(mem, code.size(), false))
+    return {};
+  return {(BlockFunc)mem, block.insts.size() - ticked};
+#else
+  (void)block;
+  return {};
+#endif
+}
+
+template <bool CacheEnabled> void Interpreter::interpretJit() {
+  // A block is translated once it has been entered this many times
+  constexpr std::uint32_t HotThreshold = 8;
+
+  JitCompiler jit(CacheEnabled);
+  std::vector<JitCompiler::JitBlock> jitBlocks(decodedInsts.size());
+  std::vector<std::uint32_t> entered(decodedInsts.size());
+  JitCompiler::Context ctx;
+  ctx.regs = regs.data();
+  ctx.memory = cache.getMemory().first;
+  ctx.cache = &cache;
+
+  std::size_t numInsts = 0;
+  auto account = [&] {
+    if (++numInsts > timeout)
+      throw Timeout("");
+    cache.tick();
+  };
+
+  while (pc != Interpretable::End) {
+    if (!(0 <= pc && (std::uint32_t)pc < decodedInsts.size() * 4)) {
+      throw InvalidAddress(pc);
+    }
+    if (Interpretable::LibcFuncStart <= (std::uint32_t)pc &&
+        (std::uint32_t)pc < Interpretable::LibcFuncEnd) {
+      account();
+      simulateLibCFunc(libc::Func(pc));
+      pc = regs[1];
+      // force the calling convention
+      int callerSaved[] = {1,  5,  6,  7,  /* 10, */ 11, 12, 13, 14,
+                           15, 16, 17, 28, 29,           30, 31};
+      for (auto reg : callerSaved)
+        regs[reg] += 0x1234;
+      continue;
+    }
+    auto block = pc % 4 == 0 ? blockCache->get(pc) : nullptr;
+    if (!block) {
+      account();
+      throw InvalidAddress(pc);
+    }
+    if (numInsts + block->insts.size() > timeout) {
+      for (const auto &inst : block->insts) {
+        account();
+        if (icache)
+          icache->fetch(pc);
+        simulate<false, CacheEnabled, false>(inst);
+        count(inst);
+        regs[0] = 0;
+        pc += 4;
+      }
+      continue;
+    }
+
+    numInsts += block->insts.size();
+    auto slot = pc / 4;
+    if (!jitBlocks[slot].func && entered[slot] != HotThreshold &&
+        ++entered[slot] == HotThreshold) {
+      jitBlocks[slot] = jit.compile(*block);
+      // the blocks translated before may not be executable any more
+      if (jit.isDisabled())
+        std::fill(jitBlocks.begin(), jitBlocks.end(), JitCompiler::JitBlock{});
+    }
+    const auto &jitBlock = jitBlocks[slot];
+    if (!jitBlock.func) {
+      simulate<CacheEnabled, false>(*block);
+      continue;
+    }
+    instCnt.simple += block->simple;
+    instCnt.mul += block->mul;
+    instCnt.br += block->br;
+    instCnt.div += block->div;
+    if (icache)
+      icache->fetch(pc, block->insts.size());
+    pc = jitBlock.func(&ctx);
+    if (ctx.fault)
+      throw InvalidAddress(ctx.faultAddr);
+    cache.tick(jitBlock.tailTicks);
+    if (branchPredictor) {
+      // The registers are those seen by the last instruction, unless it is
+      // a JALR, whose target is `pc`.
+      const auto &last = block->insts.back();
+      auto lastPc = block->entry + 4 * (block->insts.size() - 1);
+      if (last.op == inst::Instruction::JALR)
+        predictJump(lastPc, pc);
+      else if (inst::Instruction::BEQ <= last.op &&
+               last.op <= inst::Instruction::BGEU)
+        predictBranch(lastPc, isBranchTaken(last, regs.data()));
+    }
+  }
+  countCacheAccesses();
+}
+
+template void Interpreter::interpretJit<false>();
+template void Interpreter::interpretJit<true>();
+
+} // namespace ravel
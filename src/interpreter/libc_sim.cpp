@@ -4,6 +4,7 @@
 #include <cctype>
 #include <cstdio>
 #include <cstring>
+#include <sstream>
 #include <string>
 #include <utility>
 
@@ -185,35 +186,48 @@ namespace {
 // increased by more than once.
 // Hence, we use the rule: instCnt += size / MemSizeFactor
 constexpr std::size_t MemSizeFactor = 512;
+
+// The storage is not guarded here, cf. UnguardedScope, so ranges are checked
+// explicitly
+void checkRange(std::size_t addr, std::size_t cnt, const std::byte *storage,
+                const std::byte *storageEnd) {
+  if (addr + cnt > std::size_t(storageEnd - storage))
+    throw InvalidAddress(addr);
+}
 } // namespace
 
 void malloc(std::array<std::uint32_t, 32> &regs, std::byte *storage,
-            std::byte *storageEnd, std::size_t &heapPtr,
-            std::unordered_set<std::size_t> &malloced,
-            std::unordered_set<std::size_t> &invalidAddress,
+            std::byte *storageEnd, HeapAllocator &heap, ShadowMemory &shadow,
             std::size_t &instCnt, bool zeroInit) {
   auto size = (std::size_t)regs[10];
   instCnt += size / MemSizeFactor;
-  regs[10] = heapPtr;
-  malloced.emplace(heapPtr);
-  heapPtr += size;
-  if (zeroInit) {
-    std::fill(storage + regs[10], storage + heapPtr, std::byte(0));
-  }
-  invalidAddress.emplace(heapPtr++);
-  if (heapPtr % 2) {
-    invalidAddress.emplace(heapPtr++);
-  }
-  if (heapPtr >= storageEnd - storage) {
+  auto block = heap.allocate(size);
+  if (heap.getTop() >= storageEnd - storage) {
     throw RuntimeError("Running out of memory");
   }
+  regs[10] = block.addr;
+  if (zeroInit) {
+    std::fill(storage + block.addr, storage + block.addr + size,
+              std::byte(0));
+  }
+  // the block may be a reused one
+  shadow.unpoison(block.addr, block.addr + size);
+  // red zone
+  shadow.poison(block.addr + size, block.end);
 }
 
-void free(const std::array<std::uint32_t, 32> &regs,
-          std::unordered_set<std::size_t> &malloced) {
+void free(const std::array<std::uint32_t, 32> &regs, HeapAllocator &heap,
+          ShadowMemory &shadow) {
   std::size_t addr = regs[10];
-  assert(isIn(malloced, addr));
-  malloced.erase(malloced.find(addr));
+  if (addr == 0) // free(NULL)
+    return;
+  auto block = heap.deallocate(addr);
+  if (!block) {
+    std::stringstream ss;
+    ss << "Invalid free of " << std::hex << addr;
+    throw RuntimeError(ss.str());
+  }
+  shadow.poison(block->addr, block->end);
 }
 
 void memcpy(std::array<std::uint32_t, 32> &regs, std::byte *storage,
@@ -222,7 +236,8 @@ void memcpy(std::array<std::uint32_t, 32> &regs, std::byte *storage,
   std::size_t src = regs[11];
   std::size_t cnt = regs[12];
   instCnt += cnt / MemSizeFactor;
-  assert(src + cnt < storageEnd - storage && dest + cnt < storageEnd - storage);
+  checkRange(src, cnt, storage, storageEnd);
+  checkRange(dest, cnt, storage, storageEnd);
   std::memcpy(storage + dest, storage + src, cnt);
 }
 
@@ -236,6 +251,7 @@ void strcpy(std::array<std::uint32_t, 32> &regs, std::byte *storage,
   std::size_t dest = regs[10], src = regs[11];
   std::size_t size = std::strlen((char *)storage + src);
   instCnt += size / MemSizeFactor;
+  checkRange(dest, size + 1, storage, storageEnd);
   std::strcpy((char *)storage + dest, (char *)storage + src);
 }
 
@@ -245,6 +261,7 @@ void strcat(std::array<std::uint32_t, 32> &regs, std::byte *storage,
   auto src = (const char *)(storage + regs[11]);
   std::size_t size = std::strlen(src);
   instCnt += size / MemSizeFactor;
+  checkRange(regs[10] + std::strlen(dest), size + 1, storage, storageEnd);
   std::strcat(dest, src);
 }
 
@@ -260,6 +277,7 @@ void memset(std::array<std::uint32_t, 32> &regs, std::byte *storage,
   int ch = regs[11];
   std::size_t cnt = regs[12];
   instCnt += cnt / MemSizeFactor;
+  checkRange(dest, cnt, storage, storageEnd);
   std::memset(storage + dest, ch, cnt);
 }
 
@@ -0,0 +1,73 @@
+#include "ravel/interpreter/miss_ratio_curve.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace ravel {
+
+MissRatioCurve::MissRatioCurve(std::size_t lineSize, std::size_t maxLines)
+    : lineSize(lineSize), histogram(maxLines), tree(1 << 16) {
+  assert(lineSize != 0 && (lineSize & (lineSize - 1)) == 0);
+  while ((std::size_t(1) << lineSizePow) < lineSize)
+    ++lineSizePow;
+}
+
+void MissRatioCurve::access(std::size_t addr) {
+  ++accesses;
+  if (now == tree.size())
+    compact();
+  auto [iter, inserted] = lastAccess.try_emplace(addr >> lineSizePow, now);
+  if (!inserted) {
+    auto last = iter->second;
+    auto distance = countBefore(now) - countBefore(last + 1);
+    if (distance < histogram.size())
+      ++histogram[distance];
+    mark(last, -1);
+    iter->second = now;
+  }
+  mark(now, 1);
+  ++now;
+}
+
+std::vector<std::size_t> MissRatioCurve::getHits() const {
+  std::vector<std::size_t> hits(histogram.size() + 1);
+  for (std::size_t d = 0; d < histogram.size(); ++d)
+    hits[d + 1] = hits[d] + histogram[d];
+  return hits;
+}
+
+void MissRatioCurve::mark(std::size_t time, std::int32_t delta) {
+  for (auto i = time + 1; i <= tree.size(); i += i & -i)
+    tree[i - 1] += delta;
+}
+
+std::size_t MissRatioCurve::countBefore(std::size_t time) const {
+  std::size_t res = 0;
+  for (auto i = time; i > 0; i -= i & -i)
+    res += tree[i - 1];
+  return res;
+}
+
+void MissRatioCurve::compact() {
+  std::vector<std::pair<std::size_t, std::size_t>> byTime; // (time, line)
+  byTime.reserve(lastAccess.size());
+  for (auto &[line, time] : lastAccess)
+    byTime.emplace_back(time, line);
+  std::sort(byTime.begin(), byTime.end());
+
+  now = byTime.size();
+  tree.assign(std::max(tree.size(), 4 * now), 0);
+  for (std::size_t i = 0; i < now; ++i) {
+    lastAccess[byTime[i].second] = i;
+    tree[i] = 1;
+  }
+  // build the tree in linear time
+  for (std::size_t i = 1; i <= tree.size(); ++i) {
+    auto parent = i + (i & -i);
+    if (parent <= tree.size())
+      tree[parent - 1] += tree[i - 1];
+  }
+}
+
+} // namespace ravel
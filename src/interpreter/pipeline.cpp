@@ -0,0 +1,77 @@
+#include "ravel/interpreter/pipeline.h"
+
+#include <algorithm>
+
+namespace ravel {
+
+void PipelineModel::step(const DecodedInst &inst, bool taken,
+                         std::size_t memMisses, std::size_t mispredictions) {
+  using Op = inst::Instruction::OpType;
+  auto op = (Op)inst.op;
+  bool isBranch = Op::BEQ <= op && op <= Op::BGEU;
+  bool isLoad = Op::LB <= op && op <= Op::LHU;
+  bool isStore = Op::SB <= op && op <= Op::SW;
+  bool isMul = Op::MUL <= op && op <= Op::MULHU;
+  bool isDiv = Op::DIV <= op && op <= Op::REMU;
+  bool readsRs1 = !(op == Op::LUI || op == Op::AUIPC || op == Op::JAL);
+  bool readsRs2 = isBranch || isStore || (Op::ADD <= op && op <= Op::REMU);
+  bool writesRd = !(isBranch || isStore);
+
+  ++stats.insts;
+  auto issue = nextIssue;
+  auto waitFor = [&](std::uint8_t reg) {
+    if (reg == 0 || ready[reg] <= issue)
+      return;
+    auto &stall =
+        producer[reg] == Producer::Load ? stats.loadUse : stats.mulDiv;
+    stall += ready[reg] - issue;
+    issue = ready[reg];
+  };
+  if (readsRs1)
+    waitFor(inst.rs1);
+  if (readsRs2)
+    waitFor(inst.rs2);
+  if (isDiv && divBusyUntil > issue) {
+    stats.structural += divBusyUntil - issue;
+    issue = divBusyUntil;
+  }
+
+  std::size_t memStall = 0;
+  if (isLoad || isStore) {
+    memStall = (memMisses - lastMemMisses) * config.memPenalty;
+    stats.memory += memStall;
+  }
+  lastMemMisses = memMisses;
+
+  if (writesRd && inst.rd != 0) {
+    if (isLoad) {
+      ready[inst.rd] = issue + 2 + memStall;
+      producer[inst.rd] = Producer::Load;
+    } else if (isMul || isDiv) {
+      ready[inst.rd] = issue + (isMul ? config.mulLatency : config.divLatency);
+      producer[inst.rd] = Producer::MulDiv;
+    } else {
+      ready[inst.rd] = issue + 1;
+      producer[inst.rd] = Producer::Alu;
+    }
+  }
+  if (isDiv)
+    divBusyUntil = issue + config.divLatency;
+
+  std::size_t controlStall = 0;
+  bool mispredicted = mispredictions != lastMispredictions;
+  lastMispredictions = mispredictions;
+  if (op == Op::JAL)
+    controlStall = config.jumpPenalty;
+  else if (isBranch || op == Op::JALR)
+    controlStall = (config.predicted ? mispredicted : taken || op == Op::JALR)
+                       ? config.branchPenalty
+                       : 0;
+  stats.control += controlStall;
+
+  nextIssue = issue + 1 + memStall + controlStall;
+  // the instruction leaves WB two cycles after leaving EX
+  stats.cycles = std::max(stats.cycles, issue + 3 + memStall);
+}
+
+} // namespace ravel
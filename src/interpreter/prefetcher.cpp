@@ -0,0 +1,74 @@
+#include "ravel/interpreter/prefetcher.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "ravel/error.h"
+
+namespace ravel {
+namespace {
+
+bool isPowerOfTwo(std::size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+} // namespace
+
+Prefetcher::Prefetcher(const PrefetcherConfig &config, std::size_t lineSize)
+    : config(config), lineSize(lineSize) {
+  if (config.degree == 0 || !isPowerOfTwo(config.tableEntries) ||
+      !isPowerOfTwo(config.regionSize))
+    throw Exception("Invalid prefetcher configuration");
+  if (config.kind == PrefetcherKind::Stride)
+    table.resize(config.tableEntries);
+  targets.reserve(config.degree);
+}
+
+const std::vector<std::size_t> &Prefetcher::access(std::size_t addr) {
+  targets.clear();
+  switch (config.kind) {
+  case PrefetcherKind::NextLine: {
+    auto line = addr & ~(lineSize - 1);
+    for (std::size_t i = 1; i <= config.degree; ++i)
+      targets.emplace_back(line + i * lineSize);
+    break;
+  }
+  case PrefetcherKind::Stride:
+    trainStride(addr);
+    break;
+  }
+  return targets;
+}
+
+void Prefetcher::trainStride(std::size_t addr) {
+  auto region = addr / config.regionSize;
+  auto &entry = table[region & (config.tableEntries - 1)];
+  if (!entry.valid || entry.region != region) {
+    entry = {region, addr, 0, 0, true};
+    return;
+  }
+  auto stride = std::int64_t(addr) - std::int64_t(entry.lastAddr);
+  entry.lastAddr = addr;
+  if (stride == 0)
+    return;
+  if (stride != entry.stride) {
+    entry.stride = stride;
+    entry.confidence = 0;
+    return;
+  }
+  if (entry.confidence < 3)
+    ++entry.confidence;
+  if (entry.confidence < 2)
+    return;
+  // Strides shorter than a line would prefetch the line being accessed, so
+  // step by at least a line.
+  auto step = std::max<std::int64_t>(std::abs(stride), lineSize);
+  if (stride < 0)
+    step = -step;
+  for (std::size_t i = 1; i <= config.degree; ++i) {
+    auto target = std::int64_t(addr) + std::int64_t(i) * step;
+    if (target < 0)
+      break;
+    targets.emplace_back(target);
+  }
+}
+
+} // namespace ravel
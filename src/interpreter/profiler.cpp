@@ -0,0 +1,160 @@
+#include "ravel/interpreter/profiler.h"
+
+#include <algorithm>
+
+namespace ravel {
+
+Profiler::Profiler(const Interpretable &interpretable)
+    : libcFuncs(Interpretable::LibcFuncEnd, 0),
+      slot2Func(interpretable.getStorage().size() / 4, 0) {
+  functions.push_back({"_start", Interpretable::Start, {}});
+  std::vector<bool> isText(slot2Func.size());
+  for (auto pos : interpretable.getInstPositions())
+    isText[pos / 4] = true;
+
+  std::size_t prevSlot = 0;
+  std::size_t prevFunc = 0;
+  for (auto &[name, addr] : interpretable.getSymbols()) {
+    if (addr < Interpretable::LibcFuncEnd) {
+      // skip _start and the aliases like __isoc99_scanf
+      if (addr < Interpretable::LibcFuncStart || name.rfind("__", 0) == 0 ||
+          libcFuncs[addr] != 0)
+        continue;
+      libcFuncs[addr] = functions.size();
+      functions.push_back({name, (std::uint32_t)addr, {}});
+      continue;
+    }
+    if (name.front() == '.' || addr % 4 != 0 || !isText.at(addr / 4))
+      continue;
+    // another symbol of the previous function
+    if (prevFunc != 0 && functions[prevFunc].entry == addr)
+      continue;
+    std::fill(slot2Func.begin() + prevSlot, slot2Func.begin() + addr / 4,
+              prevFunc);
+    prevSlot = addr / 4;
+    prevFunc = functions.size();
+    functions.push_back({name, (std::uint32_t)addr, {}});
+  }
+  std::fill(slot2Func.begin() + prevSlot, slot2Func.end(), prevFunc);
+}
+
+void Profiler::Counters::addDifference(const Counters &now,
+                                       const Counters &before) {
+  simple += now.simple - before.simple;
+  mul += now.mul - before.mul;
+  cache += now.cache - before.cache;
+  br += now.br - before.br;
+  div += now.div - before.div;
+  mem += now.mem - before.mem;
+  libcIO += now.libcIO - before.libcIO;
+  libcMem += now.libcMem - before.libcMem;
+  icache += now.icache - before.icache;
+  imem += now.imem - before.imem;
+  brMiss += now.brMiss - before.brMiss;
+  lowerCacheTime += now.lowerCacheTime - before.lowerCacheTime;
+}
+
+void Profiler::enableCallGraph() {
+  if (callPaths.empty())
+    callPaths.push_back({0, 0, 1, {}});
+}
+
+void Profiler::enter(std::uint32_t pc, const Counters &totals) {
+  flush(totals);
+  current = getFunction(pc);
+}
+
+void Profiler::finish(const Counters &totals) { flush(totals); }
+
+void Profiler::call(std::uint32_t target, const Counters &totals) {
+  flush(totals);
+  auto func = getFunction(target);
+  auto key = (std::uint64_t)currentPath << 32u | func;
+  auto [iter, inserted] = children.emplace(key, callPaths.size());
+  if (inserted)
+    callPaths.push_back({func, currentPath, 0, {}});
+  currentPath = iter->second;
+  ++callPaths[currentPath].calls;
+}
+
+void Profiler::ret(const Counters &totals) {
+  flush(totals);
+  // the root is its own parent
+  currentPath = callPaths[currentPath].parent;
+}
+
+void Profiler::flush(const Counters &totals) {
+  functions[current].counters.addDifference(totals, last);
+  if (!callPaths.empty())
+    callPaths[currentPath].counters.addDifference(totals, last);
+  last = totals;
+}
+
+std::vector<Profiler::CallGraphEntry>
+Profiler::getCallGraphSummary(const TimeFunc &time) const {
+  std::vector<std::size_t> inclusive(callPaths.size());
+  for (std::size_t i = 0; i < callPaths.size(); ++i)
+    inclusive[i] = time(callPaths[i].counters);
+  // the children come after their parents
+  for (std::size_t i = callPaths.size(); i-- > 1;)
+    inclusive[callPaths[i].parent] += inclusive[i];
+
+  std::vector<CallGraphEntry> res(functions.size());
+  // the # of times each function is on the current path
+  std::vector<std::size_t> onPath(functions.size());
+  walkCallPaths(
+      [&](std::size_t i) {
+        auto &path = callPaths[i];
+        auto &entry = res[path.func];
+        if (onPath[path.func]++ == 0)
+          entry.inclusive += inclusive[i];
+        entry.exclusive += time(path.counters);
+        entry.calls += path.calls;
+      },
+      [&](std::size_t i) { --onPath[callPaths[i].func]; });
+  return res;
+}
+
+void Profiler::printFoldedStacks(std::ostream &os, const TimeFunc &time) const {
+  std::string stack;
+  std::vector<std::size_t> lengths;
+  walkCallPaths(
+      [&](std::size_t i) {
+        lengths.emplace_back(stack.size());
+        if (!stack.empty())
+          stack += ';';
+        stack += functions[callPaths[i].func].name;
+        if (auto exclusive = time(callPaths[i].counters))
+          os << stack << ' ' << exclusive << '\n';
+      },
+      [&](std::size_t) {
+        stack.resize(lengths.back());
+        lengths.pop_back();
+      });
+}
+
+void Profiler::walkCallPaths(
+    const std::function<void(std::size_t)> &enter,
+    const std::function<void(std::size_t)> &leave) const {
+  if (callPaths.empty())
+    return;
+  std::vector<std::vector<std::size_t>> childList(callPaths.size());
+  for (std::size_t i = 1; i < callPaths.size(); ++i)
+    childList[callPaths[i].parent].emplace_back(i);
+  // (a call path, the # of its children visited)
+  std::vector<std::pair<std::size_t, std::size_t>> stack = {{0, 0}};
+  enter(0);
+  while (!stack.empty()) {
+    auto &[path, visited] = stack.back();
+    if (visited == childList[path].size()) {
+      leave(path);
+      stack.pop_back();
+      continue;
+    }
+    auto child = childList[path][visited++];
+    enter(child);
+    stack.emplace_back(child, 0);
+  }
+}
+
+} // namespace ravel
@@ -0,0 +1,41 @@
+#include "ravel/interpreter/shadow_memory.h"
+
+#include <algorithm>
+
+namespace ravel {
+namespace {
+
+// Set or clear the bits [begin, end) of `bits`, a whole word at a time where
+// possible.
+void assign(std::vector<std::uint64_t> &bits, std::size_t begin,
+            std::size_t end, bool val) {
+  while (begin < end) {
+    auto word = begin / 64;
+    auto lo = begin % 64;
+    auto hi = std::min<std::size_t>(64, lo + (end - begin));
+    auto mask = hi - lo == 64 ? ~std::uint64_t(0)
+                              : ((std::uint64_t(1) << (hi - lo)) - 1) << lo;
+    if (val)
+      bits[word] |= mask;
+    else
+      bits[word] &= ~mask;
+    begin += hi - lo;
+  }
+}
+
+} // namespace
+
+void ShadowMemory::poison(std::size_t begin, std::size_t end) {
+  if (begin >= end)
+    return;
+  auto words = (end + 63) / 64;
+  if (bits.size() < words)
+    bits.resize(words);
+  assign(bits, begin, end, true);
+}
+
+void ShadowMemory::unpoison(std::size_t begin, std::size_t end) {
+  assign(bits, begin, std::min(end, bits.size() * 64), false);
+}
+
+} // namespace ravel
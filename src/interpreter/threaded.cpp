@@ -0,0 +1,377 @@
+#include "ravel/interpreter/interpreter.h"
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+#include "ravel/error.h"
+
+// The threaded interpreter. Every instruction of the decoded table is paired
+// with the address of the code handling its op, and each handler ends by
+// jumping directly to the handler of the next instruction, so there is no
+// central dispatch loop and no classification of the op at run time.
+//
+// With GCC and Clang the handler addresses are labels (labels-as-values).
+// Otherwise, or if RAVEL_COMPUTED_GOTO is not defined, the handlers are the
+// cases of a switch in a loop, which is slower but portable.
+//
+// Instructions are counted, and the timeout is checked, once per basic block
+// (cf. block_cache.h) when the block is entered. The handlers only keep the
+// cache ticking in step, so that memory accesses see the same cycle as in
+// `Interpreter::interpret()`. The end of the program, the libc functions,
+// invalid addresses and blocks in which the timeout may be reached are handled
+// by the outer loop instruction by instruction, in exactly the same way as in
+// `Interpreter::interpret()`, so `InstCnt`, the cache state and the thrown
+// exceptions are identical.
+//
+// This engine does not support `printInstructions` and `keepDebugInfo`.
+
+namespace ravel {
+
+struct Interpreter::ThreadedInst {
+  const void *handler = nullptr; // unused by the switch fallback
+  DecodedInst inst;
+};
+
+namespace {
+
+// A pseudo op for the last instruction of a block which does not transfer
+// control. It is executed by `Interpreter::simulate()`.
+constexpr std::uint8_t Generic = DecodedInst::Invalid - 1;
+constexpr std::uint8_t NumOps = inst::Instruction::REMU + 1;
+static_assert(NumOps < Generic);
+
+} // namespace
+
+template <bool CacheEnabled, bool Guarded>
+void Interpreter::interpretThreaded() {
+  std::vector<ThreadedInst> code(decodedInsts.size());
+  if (!Guarded) {
+    runThreaded<CacheEnabled, false>(code.data());
+    return;
+  }
+  std::pair<Interpreter *, ThreadedInst *> context(this, code.data());
+  interpretGuarded(
+      [](void *context) {
+        auto [self, code] =
+            *(std::pair<Interpreter *, ThreadedInst *> *)context;
+        self->runThreaded<CacheEnabled, true>(code);
+      },
+      &context);
+}
+
+template <bool CacheEnabled, bool Guarded>
+void Interpreter::runThreaded(ThreadedInst *code) {
+  using Op = inst::Instruction::OpType;
+
+#ifdef RAVEL_COMPUTED_GOTO
+#define RAVEL_HANDLER(name) name##_handler
+  // clang-format off
+  static const void *const handlers[NumOps] = {
+    &&RAVEL_HANDLER(LUI), &&RAVEL_HANDLER(AUIPC),
+    &&RAVEL_HANDLER(JAL),
+    &&RAVEL_HANDLER(JALR),
+    &&RAVEL_HANDLER(BEQ), &&RAVEL_HANDLER(BNE), &&RAVEL_HANDLER(BLT),
+    &&RAVEL_HANDLER(BGE), &&RAVEL_HANDLER(BLTU), &&RAVEL_HANDLER(BGEU),
+    &&RAVEL_HANDLER(LB), &&RAVEL_HANDLER(LH), &&RAVEL_HANDLER(LW),
+    &&RAVEL_HANDLER(LBU), &&RAVEL_HANDLER(LHU),
+    &&RAVEL_HANDLER(SB), &&RAVEL_HANDLER(SH), &&RAVEL_HANDLER(SW),
+    &&RAVEL_HANDLER(ADDI), &&RAVEL_HANDLER(SLTI), &&RAVEL_HANDLER(SLTIU),
+    &&RAVEL_HANDLER(XORI), &&RAVEL_HANDLER(ORI), &&RAVEL_HANDLER(ANDI),
+    &&RAVEL_HANDLER(SLLI), &&RAVEL_HANDLER(SRLI), &&RAVEL_HANDLER(SRAI),
+    &&RAVEL_HANDLER(ADD), &&RAVEL_HANDLER(SUB), &&RAVEL_HANDLER(SLL),
+    &&RAVEL_HANDLER(SLT), &&RAVEL_HANDLER(SLTU), &&RAVEL_HANDLER(XOR),
+    &&RAVEL_HANDLER(SRL), &&RAVEL_HANDLER(SRA), &&RAVEL_HANDLER(OR),
+    &&RAVEL_HANDLER(AND),
+    &&RAVEL_HANDLER(MUL), &&RAVEL_HANDLER(MULH), &&RAVEL_HANDLER(MULHSU),
+    &&RAVEL_HANDLER(MULHU), &&RAVEL_HANDLER(DIV), &&RAVEL_HANDLER(DIVU),
+    &&RAVEL_HANDLER(REM), &&RAVEL_HANDLER(REMU),
+  };
+  // clang-format on
+#define RAVEL_CASE(name)                                                       \
+  case Op::name:                                                               \
+    RAVEL_HANDLER(name)
+#define RAVEL_PSEUDO_CASE(name)                                                \
+  case name:                                                                   \
+    RAVEL_HANDLER(name)
+#define RAVEL_DISPATCH() goto *ip->handler
+#define RAVEL_DISPATCH_LABEL
+#else
+#define RAVEL_CASE(name) case Op::name
+#define RAVEL_PSEUDO_CASE(name) case name
+#define RAVEL_DISPATCH() goto dispatch
+#define RAVEL_DISPATCH_LABEL                                                   \
+  dispatch:
+#endif
+
+  // Build the threaded code. Only slots which may start a block are ever
+  // dispatched to, cf. `RAVEL_ENTER_BLOCK`.
+  for (std::size_t i = 0; i < decodedInsts.size(); ++i) {
+    if (!blockCache->isValid(i))
+      continue;
+    auto &threadedInst = code[i];
+    threadedInst.inst = decodedInsts[i];
+    auto op = threadedInst.inst.op;
+    if (blockCache->endsBlock(i) && !(Op::JAL <= op && op <= Op::BGEU))
+      threadedInst.inst.op = Generic;
+#ifdef RAVEL_COMPUTED_GOTO
+    if (threadedInst.inst.op == Generic)
+      threadedInst.handler = &&RAVEL_HANDLER(Generic);
+    else
+      threadedInst.handler = handlers[op];
+#endif
+  }
+  const ThreadedInst *const begin = code;
+  const std::size_t codeSize = decodedInsts.size() * 4;
+
+  std::size_t numInsts = 0;
+  const ThreadedInst *ip = nullptr;
+  // the cache has been ticked for the instructions before `tickedTo`
+  const ThreadedInst *tickedTo = nullptr;
+
+#define RAVEL_CUR_PC() (std::uint32_t)((ip - begin) * 4)
+#define RAVEL_ACCOUNT()                                                        \
+  do {                                                                         \
+    if (++numInsts > timeout)                                                  \
+      throw Timeout("");                                                       \
+    cache.tick();                                                              \
+  } while (false)
+  // tick the cache up to and including the current instruction
+#define RAVEL_TICK()                                                           \
+  do {                                                                         \
+    cache.tick(ip + 1 - tickedTo);                                             \
+    tickedTo = ip + 1;                                                         \
+  } while (false)
+#define RAVEL_NEXT()                                                           \
+  do {                                                                         \
+    ++ip;                                                                      \
+    RAVEL_DISPATCH();                                                          \
+  } while (false)
+  // Enter the block at `target`. Anything the handlers can not deal with is
+  // handed to the outer loop.
+#define RAVEL_ENTER_BLOCK(target)                                              \
+  do {                                                                         \
+    pc = (target);                                                             \
+    if (pc % 4 != 0)                                                           \
+      goto exitThreaded;                                                       \
+    auto block = blockCache->get(pc);                                          \
+    if (!block || numInsts + block->insts.size() > timeout)                    \
+      goto exitThreaded;                                                       \
+    numInsts += block->insts.size();                                           \
+    instCnt.simple += block->simple;                                           \
+    instCnt.mul += block->mul;                                                 \
+    instCnt.br += block->br;                                                   \
+    instCnt.div += block->div;                                                 \
+    if (icache)                                                                \
+      icache->fetch(pc, block->insts.size());                                  \
+    ip = tickedTo = begin + pc / 4;                                            \
+    RAVEL_DISPATCH();                                                          \
+  } while (false)
+#define RAVEL_ARITH(name, expr)                                                \
+  RAVEL_CASE(name) : {                                                         \
+    std::uint32_t rs1 = regs[ip->inst.rs1];                                    \
+    std::uint32_t rs2 = regs[ip->inst.rs2];                                    \
+    regs[ip->inst.rd] = (expr);                                                \
+    RAVEL_NEXT();                                                              \
+  }
+#define RAVEL_ARITH_IMM(name, expr)                                            \
+  RAVEL_CASE(name) : {                                                         \
+    std::uint32_t rs1 = regs[ip->inst.rs1];                                    \
+    std::uint32_t rs2 = ip->inst.imm;                                          \
+    regs[ip->inst.rd] = (expr);                                                \
+    RAVEL_NEXT();                                                              \
+  }
+#define RAVEL_BRANCH(name, cond)                                               \
+  RAVEL_CASE(name) : {                                                         \
+    RAVEL_TICK();                                                              \
+    std::int32_t rs1 = regs[ip->inst.rs1];                                     \
+    std::int32_t rs2 = regs[ip->inst.rs2];                                     \
+    auto curPc = RAVEL_CUR_PC();                                               \
+    bool taken = (cond);                                                       \
+    predictBranch(curPc, taken);                                               \
+    RAVEL_ENTER_BLOCK(taken ? curPc + ip->inst.imm : curPc + 4);               \
+  }
+  // `fetchFrom` is computed in the same way as in `Interpreter::simulate()`
+#define RAVEL_MEM_ACCESS(name, align, stmt)                                    \
+  RAVEL_CASE(name) : {                                                         \
+    RAVEL_TICK();                                                              \
+    std::size_t vAddr = regs[ip->inst.rs1] + ip->inst.imm;                     \
+    std::byte *addr = cache.getMemory().first + vAddr;                         \
+    std::size_t fetchFrom = vAddr;                                             \
+    align;                                                                     \
+    if (Guarded)                                                               \
+      pc = RAVEL_CUR_PC(); /* for the diagnostics of a fault */                \
+    cache.fetchWord<CacheEnabled, !Guarded>(fetchFrom);                        \
+    stmt;                                                                      \
+    RAVEL_NEXT();                                                              \
+  }
+#define RAVEL_ALIGN_B() fetchFrom &= ~0b11
+#define RAVEL_ALIGN_H()                                                        \
+  if (vAddr % 4 == 3)                                                          \
+    fetchFrom -= 2;                                                            \
+  else                                                                         \
+    fetchFrom &= ~0b11
+#define RAVEL_ALIGN_W() (void)0
+
+  while (pc != Interpretable::End) {
+    if (!(0 <= pc && (std::uint32_t)pc < codeSize)) {
+      throw InvalidAddress(pc);
+    }
+    if (Interpretable::LibcFuncStart <= (std::uint32_t)pc &&
+        (std::uint32_t)pc < Interpretable::LibcFuncEnd) {
+      RAVEL_ACCOUNT();
+      simulateLibCFunc(libc::Func(pc));
+      pc = regs[1];
+      // force the calling convention
+      int callerSaved[] = {1,  5,  6,  7,  /* 10, */ 11, 12, 13, 14,
+                           15, 16, 17, 28, 29,           30, 31};
+      for (auto reg : callerSaved)
+        regs[reg] += 0x1234;
+      continue;
+    }
+    auto block = pc % 4 == 0 ? blockCache->get(pc) : nullptr;
+    if (!block) {
+      RAVEL_ACCOUNT();
+      throw InvalidAddress(pc);
+    }
+    if (numInsts + block->insts.size() > timeout) {
+      for (const auto &inst : block->insts) {
+        RAVEL_ACCOUNT();
+        if (icache)
+          icache->fetch(pc);
+        simulate<false, CacheEnabled, Guarded>(inst);
+        count(inst);
+        regs[0] = 0;
+        pc += 4;
+      }
+      continue;
+    }
+
+    RAVEL_ENTER_BLOCK(pc);
+    RAVEL_DISPATCH_LABEL
+    switch (ip->inst.op) {
+      RAVEL_CASE(LUI) : {
+        regs[ip->inst.rd] = ip->inst.imm;
+        RAVEL_NEXT();
+      }
+      RAVEL_CASE(AUIPC) : {
+        regs[ip->inst.rd] = RAVEL_CUR_PC() + ip->inst.imm;
+        RAVEL_NEXT();
+      }
+      RAVEL_CASE(JAL) : {
+        RAVEL_TICK();
+        auto curPc = RAVEL_CUR_PC();
+        regs[ip->inst.rd] = curPc + 4;
+        regs[0] = 0;
+        RAVEL_ENTER_BLOCK(curPc + ip->inst.imm);
+      }
+      RAVEL_CASE(JALR) : {
+        RAVEL_TICK();
+        // the same order as in `Interpreter::simulate()`
+        regs[ip->inst.rd] = RAVEL_CUR_PC() + 4;
+        auto addr = (regs[ip->inst.rs1] + ip->inst.imm) & ~1u;
+        regs[0] = 0;
+        predictJump(RAVEL_CUR_PC(), addr);
+        RAVEL_ENTER_BLOCK(addr);
+      }
+
+      RAVEL_BRANCH(BEQ, rs1 == rs2)
+      RAVEL_BRANCH(BNE, rs1 != rs2)
+      RAVEL_BRANCH(BLT, rs1 < rs2)
+      RAVEL_BRANCH(BGE, rs1 >= rs2)
+      RAVEL_BRANCH(BLTU, (std::uint32_t)rs1 < (std::uint32_t)rs2)
+      RAVEL_BRANCH(BGEU, (std::uint32_t)rs1 >= (std::uint32_t)rs2)
+
+      RAVEL_MEM_ACCESS(LB, RAVEL_ALIGN_B(),
+                       regs[ip->inst.rd] = *(std::int8_t *)addr)
+      RAVEL_MEM_ACCESS(LH, RAVEL_ALIGN_H(),
+                       regs[ip->inst.rd] = *(std::int16_t *)addr)
+      RAVEL_MEM_ACCESS(LW, RAVEL_ALIGN_W(),
+                       regs[ip->inst.rd] = *(std::int32_t *)addr)
+      RAVEL_MEM_ACCESS(LBU, RAVEL_ALIGN_B(),
+                       regs[ip->inst.rd] = *(std::uint8_t *)addr)
+      RAVEL_MEM_ACCESS(LHU, RAVEL_ALIGN_H(),
+                       regs[ip->inst.rd] = *(std::uint16_t *)addr)
+      RAVEL_MEM_ACCESS(SB, RAVEL_ALIGN_B(),
+                       *(std::uint8_t *)addr = regs[ip->inst.rs2])
+      RAVEL_MEM_ACCESS(SH, RAVEL_ALIGN_H(),
+                       *(std::uint16_t *)addr = regs[ip->inst.rs2])
+      RAVEL_MEM_ACCESS(SW, RAVEL_ALIGN_W(),
+                       *(std::uint32_t *)addr = regs[ip->inst.rs2])
+
+      RAVEL_ARITH_IMM(ADDI, rs1 + rs2)
+      RAVEL_ARITH_IMM(SLTI, (std::int32_t)rs1 < (std::int32_t)rs2)
+      RAVEL_ARITH_IMM(SLTIU, rs1 < rs2)
+      RAVEL_ARITH_IMM(XORI, rs1 ^ rs2)
+      RAVEL_ARITH_IMM(ORI, rs1 | rs2)
+      RAVEL_ARITH_IMM(ANDI, rs1 & rs2)
+      RAVEL_ARITH_IMM(SLLI, rs1 << rs2)
+      RAVEL_ARITH_IMM(SRLI, rs1 >> rs2)
+      RAVEL_ARITH_IMM(SRAI, (std::int32_t)rs1 >> rs2)
+
+      RAVEL_ARITH(ADD, rs1 + rs2)
+      RAVEL_ARITH(SUB, (std::int32_t)rs1 - (std::int32_t)rs2)
+      RAVEL_ARITH(SLL, rs1 << rs2)
+      RAVEL_ARITH(SLT, (std::int32_t)rs1 < (std::int32_t)rs2)
+      RAVEL_ARITH(SLTU, rs1 < rs2)
+      RAVEL_ARITH(XOR, rs1 ^ rs2)
+      RAVEL_ARITH(SRL, rs1 >> rs2)
+      RAVEL_ARITH(SRA, (std::int32_t)rs1 >> rs2)
+      RAVEL_ARITH(OR, rs1 | rs2)
+      RAVEL_ARITH(AND, rs1 & rs2)
+
+      RAVEL_ARITH(MUL, (std::int32_t)rs1 * (std::int32_t)rs2)
+      // Note: uint32 -> int32 -> int64 != uint32 -> int64
+      RAVEL_ARITH(MULH, (std::uint32_t)(((std::int64_t)(std::int32_t)rs1 *
+                                         (std::int64_t)(std::int32_t)rs2) >>
+                                        32u))
+      RAVEL_ARITH(MULHSU, (std::uint32_t)(((std::int64_t)(std::int32_t)rs1 *
+                                           (std::uint64_t)rs2) >>
+                                          32u))
+      RAVEL_ARITH(MULHU,
+                  (std::uint32_t)(((std::uint64_t)rs1 * (std::uint64_t)rs2) >>
+                                  32u))
+      RAVEL_ARITH(DIV, (std::int32_t)rs1 / (std::int32_t)rs2)
+      RAVEL_ARITH(DIVU, rs1 / rs2)
+      RAVEL_ARITH(REM, (std::int32_t)rs1 % (std::int32_t)rs2)
+      RAVEL_ARITH(REMU, rs1 % rs2)
+
+      RAVEL_PSEUDO_CASE(Generic) : {
+        RAVEL_TICK();
+        pc = RAVEL_CUR_PC();
+        simulate<false, CacheEnabled, Guarded>(decodedInsts[pc / 4]);
+        regs[0] = 0;
+        RAVEL_ENTER_BLOCK(pc + 4);
+      }
+    default:
+      assert(false);
+    }
+  exitThreaded:;
+  }
+  countCacheAccesses();
+
+#undef RAVEL_HANDLER
+#undef RAVEL_CASE
+#undef RAVEL_PSEUDO_CASE
+#undef RAVEL_DISPATCH
+#undef RAVEL_DISPATCH_LABEL
+#undef RAVEL_CUR_PC
+#undef RAVEL_ACCOUNT
+#undef RAVEL_TICK
+#undef RAVEL_NEXT
+#undef RAVEL_ENTER_BLOCK
+#undef RAVEL_ARITH
+#undef RAVEL_ARITH_IMM
+#undef RAVEL_BRANCH
+#undef RAVEL_MEM_ACCESS
+#undef RAVEL_ALIGN_B
+#undef RAVEL_ALIGN_H
+#undef RAVEL_ALIGN_W
+}
+
+template void Interpreter::interpretThreaded<false, false>();
+template void Interpreter::interpretThreaded<false, true>();
+template void Interpreter::interpretThreaded<true, false>();
+template void Interpreter::interpretThreaded<true, true>();
+
+} // namespace ravel
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cstddef>
 #include <functional>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -51,6 +52,20 @@ public:
     objSymTables.emplace(objId, newTable);
   }
 
+  // Every symbol with its address, sorted by address. The global symbols of
+  // the object files are in their own tables as well.
+  std::vector<std::pair<std::string, std::size_t>> getSymbols() const {
+    std::vector<std::pair<std::string, std::size_t>> res;
+    for (auto &[_, table] : objSymTables)
+      res.insert(res.end(), table.begin(), table.end());
+    for (auto &[name, pos] : libc::getName2Pos())
+      res.emplace_back(name, pos);
+    std::sort(res.begin(), res.end(), [](auto &lhs, auto &rhs) {
+      return std::tie(lhs.second, lhs.first) < std::tie(rhs.second, rhs.first);
+    });
+    return res;
+  }
+
 private:
   std::unordered_map<ObjectFile::Id,
                      std::unordered_map<std::string, std::size_t>>
@@ -102,7 +117,7 @@ public:
       }
     }
 
-    return {storage, insts};
+    return {storage, insts, instPositions, symTable.getSymbols()};
   }
 
 private:
@@ -142,6 +157,7 @@ private:
       assert(pos + 3 < storage.size());
       *(std::uint32_t *)(storage.data() + pos) = insts.size();
       insts.emplace_back(inst);
+      instPositions.emplace_back(pos);
       inst2ObjId.emplace(inst->getId(), obj.getId());
       if (auto opt = get(obj.getContainsRelocationFunc(), inst->getId());
           opt && opt.value().type == RelocationFunction::PCREL_HI) {
@@ -226,6 +242,7 @@ private:
 
   std::vector<std::byte> storage;
   std::vector<std::shared_ptr<inst::Instruction>> insts;
+  std::vector<std::size_t> instPositions;
 };
 
 } // namespace
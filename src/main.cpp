@@ -38,10 +38,99 @@ public:
         config.sources.emplace_back(readSource(arg));
         continue;
       }
+      if (starts_with(arg, "--stats-format=")) {
+        auto value = split(arg, "=").at(1);
+        if (value == "text")
+          config.statsFormat = StatsFormat::Text;
+        else if (value == "json")
+          config.statsFormat = StatsFormat::Json;
+        else if (value == "csv")
+          config.statsFormat = StatsFormat::Csv;
+        else
+          throw Exception("Invalid stats format: " + value);
+        continue;
+      }
       if (arg == "--enable-cache") {
         config.cacheEnabled = true;
         continue;
       }
+      if (starts_with(arg, "--cache=")) {
+        handleCacheConfig(arg);
+        continue;
+      }
+      if (starts_with(arg, "--cache-inclusion=")) {
+        auto value = split(arg, "=").at(1);
+        if (value == "inclusive")
+          config.cacheInclusion = InclusionPolicy::Inclusive;
+        else if (value == "exclusive")
+          config.cacheInclusion = InclusionPolicy::Exclusive;
+        else
+          throw Exception("Invalid cache inclusion policy: " + value);
+        continue;
+      }
+      if (arg == "--icache" || starts_with(arg, "--icache=")) {
+        config.instCache = arg == "--icache" ? CacheConfig()
+                                             : parseCacheConfig(arg.substr(9));
+        continue;
+      }
+      if (arg == "--miss-ratio-curve") {
+        config.missRatioCurve = 64;
+        continue;
+      }
+      if (starts_with(arg, "--miss-ratio-curve=")) {
+        config.missRatioCurve = std::stoul(split(arg, "=").at(1));
+        continue;
+      }
+      if (starts_with(arg, "--prefetcher=")) {
+        config.prefetcher = parsePrefetcherConfig(arg.substr(13));
+        continue;
+      }
+      if (starts_with(arg, "--branch-predictor=")) {
+        handleBranchPredictor(arg);
+        continue;
+      }
+      if (starts_with(arg, "--branch-stats=")) {
+        config.branchStatsFile = split(arg, "=").at(1);
+        continue;
+      }
+      if (arg == "--pipeline" || starts_with(arg, "--pipeline=")) {
+        handlePipeline(arg);
+        continue;
+      }
+      if (arg == "--profile") {
+        config.profile = true;
+        continue;
+      }
+      if (starts_with(arg, "--profile=")) {
+        config.profile = true;
+        config.profileFile = split(arg, "=").at(1);
+        continue;
+      }
+      if (starts_with(arg, "--call-graph=")) {
+        config.callGraphFile = split(arg, "=").at(1);
+        continue;
+      }
+      if (arg == "--annotate") {
+        config.annotate = true;
+        continue;
+      }
+      if (starts_with(arg, "--annotate=")) {
+        config.annotate = true;
+        config.annotateFile = split(arg, "=").at(1);
+        continue;
+      }
+      if (starts_with(arg, "--trace=")) {
+        config.traceFile = split(arg, "=").at(1);
+        continue;
+      }
+      if (arg == "--trace-compress") {
+        config.traceCompress = true;
+        continue;
+      }
+      if (starts_with(arg, "--cost-model=")) {
+        handleCostModel(arg);
+        continue;
+      }
       if (arg == "--keep-debug-info") {
         config.keepDebugInfo = true;
         continue;
@@ -69,6 +158,22 @@ public:
         config.outputFile = tokens.at(1);
         continue;
       }
+      if (arg == "--threaded-dispatch") {
+        config.threadedDispatch = true;
+        continue;
+      }
+      if (arg == "--guard-pages") {
+        config.guardPages = true;
+        continue;
+      }
+      if (arg == "--decoupled-timing") {
+        config.decoupledTiming = true;
+        continue;
+      }
+      if (arg == "--jit") {
+        config.jit = true;
+        continue;
+      }
       if (starts_with(arg, "--print-instructions")) {
         config.printInsts = true;
         continue;
@@ -93,29 +198,187 @@ private:
   void handleInstWeight(const std::string &arg) {
     assert(starts_with(arg, "-w"));
     auto tokens = split(arg.substr(2), "=");
-    std::size_t weight = std::stoul(tokens.at(1));
-    auto type = tokens.at(0);
+    setInstWeight(config.instWeight, tokens.at(0), std::stoul(tokens.at(1)));
+  }
+
+  static void setInstWeight(InstWeight &instWeight, const std::string &type,
+                            std::size_t weight) {
     if (type == "simple")
-      config.instWeight.simple = weight;
+      instWeight.simple = weight;
     else if (type == "mul")
-      config.instWeight.mul = weight;
+      instWeight.mul = weight;
+    else if (type == "cache")
+      instWeight.cache = weight;
     else if (type == "br")
-      config.instWeight.br = weight;
+      instWeight.br = weight;
     else if (type == "div")
-      config.instWeight.div = weight;
+      instWeight.div = weight;
     else if (type == "mem")
-      config.instWeight.mem = weight;
+      instWeight.mem = weight;
     else if (type == "libcIO")
-      config.instWeight.libcIO = weight;
+      instWeight.libcIO = weight;
     else if (type == "libcMem")
-      config.instWeight.libcMem = weight;
+      instWeight.libcMem = weight;
+    else if (type == "icache")
+      instWeight.icache = weight;
+    else if (type == "imem")
+      instWeight.imem = weight;
+    else if (type == "brMiss")
+      instWeight.brMiss = weight;
     else
       assert(false);
   }
 
+  // e.g. --pipeline=mul:3,div:20,branch:2,jump:1,mem:20
+  void handlePipeline(const std::string &arg) {
+    PipelineConfig pipeline;
+    auto pos = arg.find('=');
+    auto fields = pos == std::string::npos ? std::vector<std::string>()
+                                           : split(arg.substr(pos + 1), ",");
+    for (auto &field : fields) {
+      auto tokens = split(field, ":");
+      auto key = tokens.at(0);
+      auto value = std::stoul(tokens.at(1));
+      if (key == "mul")
+        pipeline.mulLatency = value;
+      else if (key == "div")
+        pipeline.divLatency = value;
+      else if (key == "branch")
+        pipeline.branchPenalty = value;
+      else if (key == "jump")
+        pipeline.jumpPenalty = value;
+      else if (key == "mem")
+        pipeline.memPenalty = value;
+      else
+        throw Exception("Invalid pipeline configuration: " + field);
+    }
+    config.pipeline = pipeline;
+  }
+
+  // e.g. --branch-predictor=gshare,table:12,history:12,btb:512
+  void handleBranchPredictor(const std::string &arg) {
+    assert(starts_with(arg, "--branch-predictor="));
+    auto fields = split(arg.substr(19), ",");
+    BranchPredictorConfig predictor;
+    auto kind = fields.at(0);
+    if (kind == "static")
+      predictor.kind = BranchPredictorKind::StaticNotTaken;
+    else if (kind == "bimodal")
+      predictor.kind = BranchPredictorKind::Bimodal;
+    else if (kind == "gshare")
+      predictor.kind = BranchPredictorKind::Gshare;
+    else
+      throw Exception("Unknown branch predictor: " + kind);
+    for (auto iter = fields.begin() + 1; iter != fields.end(); ++iter) {
+      auto tokens = split(*iter, ":");
+      auto key = tokens.at(0);
+      auto value = std::stoul(tokens.at(1));
+      if (key == "table")
+        predictor.tableBits = value;
+      else if (key == "history")
+        predictor.historyBits = value;
+      else if (key == "btb")
+        predictor.btbEntries = value;
+      else
+        throw Exception("Invalid branch predictor configuration: " + *iter);
+    }
+    config.branchPredictor = predictor;
+  }
+
+  // e.g. --cost-model=cache:on,sets:64,ways:4,wmem:100. The weights are
+  // given by w<type> as in -w<type>=..., prefetcher:<kind> adds a prefetcher
+  // with the default options, and the remaining fields set the geometry of a
+  // single level cache, as in --cache.
+  void handleCostModel(const std::string &arg) {
+    assert(starts_with(arg, "--cost-model="));
+    CostModel model;
+    std::string geometry;
+    for (auto &field : split(arg.substr(13), ",")) {
+      auto tokens = split(field, ":");
+      auto key = tokens.at(0);
+      if (key == "cache")
+        model.cacheEnabled = tokens.at(1) == "on";
+      else if (key == "prefetcher")
+        model.prefetcher = parsePrefetcherConfig(tokens.at(1));
+      else if (key.front() == 'w' && key != "ways")
+        setInstWeight(model.instWeight, key.substr(1),
+                      std::stoul(tokens.at(1)));
+      else
+        geometry += field + ",";
+    }
+    model.cacheLevels = {parseCacheConfig(geometry)};
+    config.costModels.emplace_back(model);
+  }
+
+  // e.g. --cache=sets:64,ways:4,line:64,policy:lru,latency:16. The first
+  // occurrence configures L1, and each further one adds a level below.
+  void handleCacheConfig(const std::string &arg) {
+    assert(starts_with(arg, "--cache="));
+    if (!cacheConfigured)
+      config.cacheLevels.clear();
+    config.cacheEnabled = cacheConfigured = true;
+    config.cacheLevels.emplace_back(parseCacheConfig(arg.substr(8)));
+  }
+
+  // e.g. stride,degree:2,table:64,region:4096
+  PrefetcherConfig parsePrefetcherConfig(const std::string &str) {
+    auto fields = split(str, ",");
+    PrefetcherConfig prefetcher;
+    auto kind = fields.at(0);
+    if (kind == "next-line")
+      prefetcher.kind = PrefetcherKind::NextLine;
+    else if (kind == "stride")
+      prefetcher.kind = PrefetcherKind::Stride;
+    else
+      throw Exception("Unknown prefetcher: " + kind);
+    for (auto iter = fields.begin() + 1; iter != fields.end(); ++iter) {
+      auto tokens = split(*iter, ":");
+      auto key = tokens.at(0);
+      auto value = std::stoul(tokens.at(1));
+      if (key == "degree")
+        prefetcher.degree = value;
+      else if (key == "table")
+        prefetcher.tableEntries = value;
+      else if (key == "region")
+        prefetcher.regionSize = value;
+      else
+        throw Exception("Invalid prefetcher configuration: " + *iter);
+    }
+    return prefetcher;
+  }
+
+  CacheConfig parseCacheConfig(const std::string &str) {
+    CacheConfig level;
+    for (auto &field : split(str, ",")) {
+      auto tokens = split(field, ":");
+      auto key = tokens.at(0);
+      auto value = tokens.at(1);
+      if (key == "sets")
+        level.sets = std::stoul(value);
+      else if (key == "ways")
+        level.ways = std::stoul(value);
+      else if (key == "line")
+        level.lineSize = std::stoul(value);
+      else if (key == "latency")
+        level.latency = std::stoul(value);
+      else if (key == "policy" && value == "idle")
+        level.policy = ReplacementPolicy::Idle;
+      else if (key == "policy" && value == "lru")
+        level.policy = ReplacementPolicy::Lru;
+      else if (key == "policy" && value == "fifo")
+        level.policy = ReplacementPolicy::Fifo;
+      else if (key == "policy" && value == "random")
+        level.policy = ReplacementPolicy::Random;
+      else
+        throw Exception("Invalid cache configuration: " + field);
+    }
+    return level;
+  }
+
 private:
   const std::vector<std::string> &args;
   Config config{};
+  bool cacheConfigured = false;
 };
 
 } // namespace ravel
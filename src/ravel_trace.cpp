@@ -0,0 +1,96 @@
+// Decode the instruction traces written by `ravel --trace=<file>`
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "ravel/assembler/parser.h"
+#include "ravel/error.h"
+#include "ravel/interpreter/inst_trace.h"
+
+namespace ravel {
+namespace {
+
+struct Options {
+  std::string traceFile;
+  // only print the instructions in [from, to) ...
+  std::uint32_t from = 0;
+  std::uint32_t to = UINT32_MAX;
+  // ... and in this function, if not empty
+  std::string function;
+};
+
+bool startsWith(const std::string &str, const std::string &prefix) {
+  return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+void printUsage() {
+  std::cerr << "usage: ravel-trace [--from=<pc>] [--to=<pc>] "
+               "[--function=<name>] <trace file>\n";
+}
+
+void decode(const Options &options) {
+  InstTraceReader reader(options.traceFile);
+  InstTraceRecord record;
+  char line[128];
+  while (reader.next(record)) {
+    if (record.pc < options.from || record.pc >= options.to)
+      continue;
+    auto [name, offset] = reader.getFunction(record.pc);
+    if (!options.function.empty() && name != options.function)
+      continue;
+    int n = std::snprintf(line, sizeof(line), "0x%08x <%s+0x%x>", record.pc,
+                          name.c_str(), offset);
+    // the name might not fit
+    std::fwrite(line, 1, std::min<std::size_t>(n, sizeof(line) - 1), stdout);
+    if (record.hasReg) {
+      std::printf("\t%s = %u", regNumber2regName(record.reg).c_str(),
+                  record.value);
+    }
+    if (record.hasAddr)
+      std::printf("\t[0x%08x]", record.addr);
+    std::putchar('\n');
+  }
+}
+
+} // namespace
+} // namespace ravel
+
+int main(int argc, char *argv[]) {
+  using namespace ravel;
+  Options options;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (startsWith(arg, "--from=")) {
+        options.from = std::stoul(arg.substr(7), nullptr, 0);
+      } else if (startsWith(arg, "--to=")) {
+        options.to = std::stoul(arg.substr(5), nullptr, 0);
+      } else if (startsWith(arg, "--function=")) {
+        options.function = arg.substr(11);
+      } else if (arg.front() != '-' && options.traceFile.empty()) {
+        options.traceFile = arg;
+      } else {
+        printUsage();
+        return 1;
+      }
+    }
+  } catch (std::logic_error &) { // std::stoul
+    printUsage();
+    return 1;
+  }
+  if (options.traceFile.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  try {
+    decode(options);
+  } catch (Exception &e) {
+    std::cerr << "ravel-trace: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -1,26 +1,64 @@
 #include "ravel/simulator.h"
 
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <string>
+#include <tuple>
 
+#include "ravel/container_utils.h"
 #include "ravel/error.h"
 
 namespace ravel {
 
-Interpretable Simulator::buildInterpretable() {
+std::vector<SimulationResult::Field> SimulationResult::getFields() const {
+  std::vector<Field> fields = {{"exitCode", exitCode},
+                               {"memoryLeak", memoryLeak, true},
+                               {"time", time}};
+  for (std::size_t i = 0; i < costModelTimes.size(); ++i)
+    fields.push_back({"time[" + std::to_string(i + 1) + "]",
+                      costModelTimes[i]});
+  append(fields, {{"simple", instCnt.simple},
+                  {"mul", instCnt.mul},
+                  {"cache", instCnt.cache},
+                  {"br", instCnt.br},
+                  {"div", instCnt.div},
+                  {"mem", instCnt.mem},
+                  {"libcIO", instCnt.libcIO},
+                  {"libcMem", instCnt.libcMem},
+                  {"icache", instCnt.icache},
+                  {"imem", instCnt.imem},
+                  {"brMiss", instCnt.brMiss}});
+  for (std::size_t i = 0; i < cacheHitMiss.size(); ++i) {
+    auto level = "L" + std::to_string(i + 1);
+    fields.push_back({level + "Hit", cacheHitMiss[i].first});
+    fields.push_back({level + "Miss", cacheHitMiss[i].second});
+  }
+  append(fields, {{"prefetches", prefetches},
+                  {"usefulPrefetches", usefulPrefetches},
+                  {"peakMemory", peakMemory},
+                  {"buildTime", buildTime},
+                  {"interpretTime", interpretTime}});
+  return fields;
+}
+
+Interpretable Simulator::buildInterpretable(SimulationResult &result) {
   auto startTp = std::chrono::high_resolution_clock::now();
 
   std::vector<ObjectFile> objs;
   for (auto &src : config.sources)
     objs.emplace_back(assemble(src));
 
+  auto interp = link(objs);
+
   auto buildEndTp = std::chrono::high_resolution_clock::now();
   auto time = std::chrono::duration_cast<std::chrono::milliseconds>(buildEndTp -
                                                                     startTp)
                   .count();
-  auto interp = link(objs);
   std::cerr << "\nBuild finished in " << time << " ms\n";
+  result.buildTime = time;
   return interp;
 }
 
@@ -35,11 +73,81 @@ std::pair<FILE *, FILE *> Simulator::getIOFile() const {
   return {in, out};
 }
 
-void Simulator::printResult(const Interpreter &interpreter) const {
+SimulationResult Simulator::getResult(const Interpreter &interpreter) const {
+  SimulationResult result;
+  result.exitCode = interpreter.getReturnCode();
+  result.memoryLeak = interpreter.hasMemoryLeak();
+  result.time = interpreter.getTimeConsumed();
+  for (std::size_t i = 0; i < interpreter.getNumCostModels(); ++i)
+    result.costModelTimes.emplace_back(interpreter.getTimeConsumed(i));
+  result.instCnt = interpreter.getInstCnt();
+  if (config.cacheEnabled) {
+    for (auto &level : interpreter.getCacheLevels())
+      result.cacheHitMiss.emplace_back(level.getHitMiss());
+    if (interpreter.hasPrefetcher())
+      std::tie(result.prefetches, result.usefulPrefetches) =
+          interpreter.getPrefetches();
+  }
+  result.peakMemory = interpreter.getPeakMemory();
+  return result;
+}
+
+void Simulator::printResult(const Interpreter &interpreter,
+                            const SimulationResult &result) const {
   std::cout << std::endl;
+  if (config.statsFormat == StatsFormat::Text)
+    printStats(interpreter);
+  else
+    printStats(result);
+  auto &predictor = interpreter.getBranchPredictor();
+  if (predictor && !config.branchStatsFile.empty()) {
+    std::ofstream os(config.branchStatsFile);
+    predictor->printStats(os);
+  }
+  if (auto &pipeline = interpreter.getPipelineModel()) {
+    auto stats = pipeline->getStats();
+    std::cout << "pipeline:\n";
+    std::cout << "# cycles  = " << stats.cycles << std::endl;
+    std::cout << "# insts   = " << stats.insts << std::endl;
+    std::cout << "CPI       = "
+              << (stats.insts ? (double)stats.cycles / stats.insts : 0)
+              << std::endl;
+    std::cout << "# stalls (load-use)   = " << stats.loadUse << std::endl;
+    std::cout << "# stalls (mul/div)    = " << stats.mulDiv << std::endl;
+    std::cout << "# stalls (structural) = " << stats.structural << std::endl;
+    std::cout << "# stalls (control)    = " << stats.control << std::endl;
+    std::cout << "# stalls (memory)     = " << stats.memory << std::endl;
+  }
+  if (config.profile)
+    printProfile(interpreter);
+  if (!config.callGraphFile.empty())
+    printCallGraph(interpreter);
+  if (config.annotate && config.annotateFile.empty()) {
+    std::cout << "annotated assembly:\n";
+    interpreter.printAnnotation(std::cout);
+  } else if (config.annotate) {
+    std::ofstream os(config.annotateFile);
+    interpreter.printAnnotation(os);
+  }
+  if (auto &curve = interpreter.getMissRatioCurve()) {
+    std::cout << "miss ratio curve (fully associative LRU, "
+              << curve->getLineSize() << "-byte lines):\n";
+    std::cout << "# lines\thit\tmiss\n";
+    auto hits = curve->getHits();
+    for (std::size_t lines = 1; lines < hits.size(); ++lines) {
+      std::cout << lines << '\t' << hits[lines] << '\t'
+                << curve->getAccesses() - hits[lines] << '\n';
+    }
+  }
+}
+
+void Simulator::printStats(const Interpreter &interpreter) const {
   std::cout << "exit code: " << interpreter.getReturnCode() << std::endl;
   std::cout << "memory leak: " << interpreter.hasMemoryLeak() << std::endl;
   std::cout << "time: " << interpreter.getTimeConsumed() << std::endl;
+  for (std::size_t i = 0; i < interpreter.getNumCostModels(); ++i)
+    std::cout << "time[" << i + 1 << "]: " << interpreter.getTimeConsumed(i)
+              << std::endl;
   std::cout << "# instructions:\n";
   auto iCnt = interpreter.getInstCnt();
   std::cout << "# simple  = " << iCnt.simple
@@ -49,12 +157,133 @@ void Simulator::printResult(const Interpreter &interpreter) const {
   std::cout << "# br      = " << iCnt.br << std::endl;
   std::cout << "# div     = " << iCnt.div << std::endl;
   std::cout << "# mem     = " << iCnt.mem << " (a.k.a cache miss)" << std::endl;
+  auto &levels = interpreter.getCacheLevels();
+  if (config.cacheEnabled && levels.size() > 1) {
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+      auto [hit, miss] = levels[i].getHitMiss();
+      std::cout << "# L" << i + 1 << " hit = " << hit << ", miss = " << miss
+                << std::endl;
+    }
+  }
+  if (config.cacheEnabled && interpreter.hasPrefetcher()) {
+    auto [issued, useful] = interpreter.getPrefetches();
+    std::cout << "# prefetch = " << issued << " (useful = " << useful
+              << ", useless = " << issued - useful << ")" << std::endl;
+  }
   std::cout << "# libcIO  = " << iCnt.libcIO << std::endl;
   std::cout << "# libcMem = " << iCnt.libcMem << std::endl;
+  if (interpreter.isInstCacheEnabled()) {
+    std::cout << "# icache  = " << iCnt.icache << std::endl;
+    std::cout << "# imem    = " << iCnt.imem << " (a.k.a I-cache miss)"
+              << std::endl;
+  }
+  if (interpreter.getBranchPredictor()) {
+    std::cout << "# brMiss  = " << iCnt.brMiss << " (mispredictions)"
+              << std::endl;
+  }
+}
+
+void Simulator::printStats(const SimulationResult &result) const {
+  auto fields = result.getFields();
+  if (config.statsFormat == StatsFormat::Json) {
+    // a single line, so that it is easy to pick out
+    std::cout << '{';
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      std::cout << (i == 0 ? "" : ", ") << '"' << fields[i].name << "\": ";
+      if (fields[i].isBool)
+        std::cout << (fields[i].value ? "true" : "false");
+      else
+        std::cout << fields[i].value;
+    }
+    std::cout << "}\n";
+    return;
+  }
+  for (std::size_t i = 0; i < fields.size(); ++i)
+    std::cout << (i == 0 ? "" : ",") << fields[i].name;
+  std::cout << '\n';
+  for (std::size_t i = 0; i < fields.size(); ++i)
+    std::cout << (i == 0 ? "" : ",") << fields[i].value;
+  std::cout << '\n';
+}
+
+void Simulator::printProfile(const Interpreter &interpreter) const {
+  std::vector<std::pair<std::size_t, const Profiler::Function *>> funcs;
+  for (auto &func : interpreter.getProfiler()->getFunctions())
+    funcs.emplace_back(interpreter.getTimeConsumed(func.counters), &func);
+  std::stable_sort(funcs.begin(), funcs.end(), [](auto &lhs, auto &rhs) {
+    return lhs.first > rhs.first;
+  });
+  auto total = std::max<std::size_t>(interpreter.getTimeConsumed(), 1);
+
+  std::cout << "profile:\n";
+  std::cout << std::setw(12) << "time" << std::setw(8) << "share"
+            << std::setw(12) << "simple" << std::setw(10) << "mul"
+            << std::setw(10) << "br" << std::setw(10) << "div"
+            << std::setw(12) << "cache" << std::setw(10) << "mem"
+            << std::setw(8) << "libc"
+            << "  function\n";
+  for (auto [time, func] : funcs) {
+    if (time == 0)
+      break;
+    const auto &cnt = func->counters;
+    std::cout << std::setw(12) << time << std::setw(7) << std::fixed
+              << std::setprecision(2) << 100.0 * time / total << '%'
+              << std::setw(12) << cnt.simple << std::setw(10) << cnt.mul
+              << std::setw(10) << cnt.br << std::setw(10) << cnt.div
+              << std::setw(12) << cnt.cache << std::setw(10) << cnt.mem
+              << std::setw(8) << cnt.libcIO + cnt.libcMem << "  "
+              << func->name << '\n';
+  }
+  std::cout << std::defaultfloat;
+
+  if (config.profileFile.empty())
+    return;
+  std::ofstream os(config.profileFile);
+  os << "function,entry,time,simple,mul,cache,br,div,mem,libcIO,libcMem,"
+        "icache,imem,brMiss,lowerCacheTime\n";
+  for (auto [time, func] : funcs) {
+    const auto &cnt = func->counters;
+    os << func->name << ',' << func->entry << ',' << time << ','
+       << cnt.simple << ',' << cnt.mul << ',' << cnt.cache << ',' << cnt.br
+       << ',' << cnt.div << ',' << cnt.mem << ',' << cnt.libcIO << ','
+       << cnt.libcMem << ',' << cnt.icache << ',' << cnt.imem << ','
+       << cnt.brMiss << ',' << cnt.lowerCacheTime << '\n';
+  }
 }
 
-std::size_t Simulator::simulate() {
-  auto interp = buildInterpretable();
+void Simulator::printCallGraph(const Interpreter &interpreter) const {
+  const auto &profiler = *interpreter.getProfiler();
+  auto time = [&interpreter](const Profiler::Counters &counters) {
+    return interpreter.getTimeConsumed(counters);
+  };
+  auto summary = profiler.getCallGraphSummary(time);
+  std::vector<std::size_t> order(summary.size());
+  for (std::size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&summary](auto lhs, auto rhs) {
+    return summary[lhs].inclusive > summary[rhs].inclusive;
+  });
+
+  std::cout << "call graph:\n";
+  std::cout << std::setw(12) << "inclusive" << std::setw(12) << "exclusive"
+            << std::setw(10) << "calls"
+            << "  function\n";
+  for (auto i : order) {
+    const auto &entry = summary[i];
+    if (entry.inclusive == 0)
+      break;
+    std::cout << std::setw(12) << entry.inclusive << std::setw(12)
+              << entry.exclusive << std::setw(10) << entry.calls << "  "
+              << profiler.getFunctions()[i].name << '\n';
+  }
+
+  std::ofstream os(config.callGraphFile);
+  profiler.printFoldedStacks(os, time);
+}
+
+SimulationResult Simulator::simulate() {
+  SimulationResult buildResult;
+  auto interp = buildInterpretable(buildResult);
   auto [in, out] = getIOFile();
   std::shared_ptr<void> close(nullptr, [in = in, out = out](void *) {
     if (in != stdin)
@@ -68,8 +297,8 @@ std::size_t Simulator::simulate() {
   auto regsPtr =
       regs.index() == 0 ? std::get<0>(regs).data() : std::get<1>(regs);
   auto storagePtr = storage.index() == 0
-                        ? std::make_pair(&std::get<0>(storage).front(),
-                                         &std::get<0>(storage).back() + 1)
+                        ? std::make_pair(std::get<0>(storage)->begin(),
+                                         std::get<0>(storage)->end())
                         : std::get<1>(storage);
 
   Interpreter interpreter{interp, regsPtr, storagePtr.first, storagePtr.second,
@@ -77,20 +306,56 @@ std::size_t Simulator::simulate() {
 
   interpreter.setTimeout(config.timeout);
   interpreter.setKeepDebugInfo(config.keepDebugInfo);
+  interpreter.setCacheConfig(config.cacheLevels, config.cacheInclusion);
+  if (config.prefetcher)
+    interpreter.setPrefetcher(*config.prefetcher);
   if (!config.cacheEnabled)
     interpreter.disableCache();
+  if (config.branchPredictor)
+    interpreter.enableBranchPredictor(*config.branchPredictor);
+  if (config.pipeline) {
+    auto pipeline = *config.pipeline;
+    pipeline.predicted = config.branchPredictor.has_value();
+    interpreter.enablePipelineModel(pipeline);
+  }
+  for (auto &model : config.costModels)
+    interpreter.addCostModel(model);
+  if (config.instCache)
+    interpreter.enableInstCache(*config.instCache);
+  if (config.profile)
+    interpreter.enableProfiler();
+  if (!config.callGraphFile.empty())
+    interpreter.enableCallGraph();
+  if (config.annotate)
+    interpreter.enableAnnotation();
+  if (!config.traceFile.empty())
+    interpreter.enableTrace(config.traceFile, config.traceCompress);
+  if (config.missRatioCurve)
+    interpreter.enableMissRatioCurve(config.cacheLevels.front().lineSize,
+                                     config.missRatioCurve);
   if (config.printInsts)
     interpreter.enablePrintInstructions();
+  if (config.threadedDispatch)
+    interpreter.enableThreadedDispatch();
+  if (config.jit)
+    interpreter.enableJit();
+  if (config.decoupledTiming)
+    interpreter.enableDecoupledTiming();
+  if (storage.index() == 0 && std::get<0>(storage)->isGuarded())
+    interpreter.enableGuardPages();
   interpreter.interpret();
-  printResult(interpreter);
 
   auto endTp = std::chrono::high_resolution_clock::now();
   auto time =
       std::chrono::duration_cast<std::chrono::milliseconds>(endTp - starTp)
           .count();
+  auto result = getResult(interpreter);
+  result.buildTime = buildResult.buildTime;
+  result.interpretTime = time;
+  printResult(interpreter, result);
   std::cerr << "\nInterpretation finished in " << time << " ms\n";
 
-  return interpreter.getTimeConsumed();
+  return result;
 }
 
 Simulator::Simulator(Config config_) : config(std::move(config_)) {
@@ -107,7 +372,8 @@ Simulator::Simulator(Config config_) : config(std::move(config_)) {
     storage =
         std::make_pair(config.externalStorageBegin, config.externalStorageEnd);
   } else {
-    storage = std::vector<std::byte>(config.maxStorageSize);
+    storage = std::make_unique<GuestMemory>(
+        config.maxStorageSize, config.lazyStorage, config.guardPages);
   }
 }
 
@@ -121,8 +387,7 @@ std::size_t simulate(const std::string &src, std::uint32_t *regs,
   config.externalStorageEnd = storageEnd;
 
   Simulator simulator(config);
-  auto timeConsumed = simulator.simulate();
-  return timeConsumed;
+  return simulator.simulate().time;
 }
 
 } // namespace ravel
\ No newline at end of file
@@ -0,0 +1,143 @@
+# #include <stdlib.h>
+#
+# // Check the simulated malloc and free against the layout documented in
+# // heap_allocator.h. Returns 0, or the number of the first failed check.
+# int main() {
+#   free(NULL);
+#   // every block is followed by a red zone which makes its end even
+#   char *a = malloc(5), *b = malloc(6), *c = malloc(16);
+#   if (b != a + 6)
+#     return 1;
+#   if (c != b + 8)
+#     return 2;
+#   // a freed block is reused
+#   free(a);
+#   if (malloc(5) != a)
+#     return 3;
+#   // a and b are coalesced into a free block of 14 bytes
+#   free(a);
+#   free(b);
+#   char *d = malloc(12);
+#   if (d != a)
+#     return 4;
+#   // freeing the last block lowers the top of the heap
+#   free(c);
+#   char *e = malloc(64);
+#   if (e != c)
+#     return 5;
+#   // the heap does not grow
+#   for (int i = 0; i < 1000; ++i) {
+#     char *p = malloc(100), *q = malloc(200);
+#     free(p);
+#     free(q);
+#     if (p != e + 66)
+#       return 6;
+#   }
+#   // the heap is empty again
+#   free(d);
+#   free(e);
+#   char *f = malloc(4);
+#   if (f != a)
+#     return 7;
+#   free(f);
+#   return 0;
+# }
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp,sp,-48
+	sw	ra,44(sp)
+	sw	s1,40(sp)
+	sw	s2,36(sp)
+	sw	s3,32(sp)
+	sw	s4,28(sp)
+	sw	s5,24(sp)
+	sw	s6,20(sp)
+	sw	s7,16(sp)
+	sw	s8,12(sp)
+	li	a0,0
+	call	free
+	li	a0,5
+	call	malloc
+	mv	s1,a0
+	li	a0,6
+	call	malloc
+	mv	s2,a0
+	li	a0,16
+	call	malloc
+	mv	s3,a0
+	addi	a5,s1,6
+	li	a0,1
+	bne	s2,a5,.L9
+	addi	a5,s2,8
+	li	a0,2
+	bne	s3,a5,.L9
+	mv	a0,s1
+	call	free
+	li	a0,5
+	call	malloc
+	mv	a5,a0
+	li	a0,3
+	bne	a5,s1,.L9
+	mv	a0,s1
+	call	free
+	mv	a0,s2
+	call	free
+	li	a0,12
+	call	malloc
+	mv	s4,a0
+	li	a0,4
+	bne	s4,s1,.L9
+	mv	a0,s3
+	call	free
+	li	a0,64
+	call	malloc
+	mv	s5,a0
+	li	a0,5
+	bne	s5,s3,.L9
+	li	s6,0
+.L3:
+	li	a0,100
+	call	malloc
+	mv	s7,a0
+	li	a0,200
+	call	malloc
+	mv	s8,a0
+	mv	a0,s7
+	call	free
+	mv	a0,s8
+	call	free
+	addi	a5,s5,66
+	li	a0,6
+	bne	s7,a5,.L9
+	addi	s6,s6,1
+	li	a5,1000
+	blt	s6,a5,.L3
+	mv	a0,s4
+	call	free
+	mv	a0,s5
+	call	free
+	li	a0,4
+	call	malloc
+	mv	s7,a0
+	li	a0,7
+	bne	s7,s1,.L9
+	mv	a0,s7
+	call	free
+	li	a0,0
+.L9:
+	lw	ra,44(sp)
+	lw	s1,40(sp)
+	lw	s2,36(sp)
+	lw	s3,32(sp)
+	lw	s4,28(sp)
+	lw	s5,24(sp)
+	lw	s6,20(sp)
+	lw	s7,16(sp)
+	lw	s8,12(sp)
+	addi	sp,sp,48
+	jr	ra
+	.size	main, .-main
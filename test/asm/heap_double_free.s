@@ -0,0 +1,30 @@
+# #include <stdlib.h>
+#
+# // The second free is an error.
+# int main() {
+#   char *a = malloc(4);
+#   free(a);
+#   free(a);
+#   return 0;
+# }
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp,sp,-16
+	sw	ra,12(sp)
+	sw	s1,8(sp)
+	li	a0,4
+	call	malloc
+	mv	s1,a0
+	call	free
+	mv	a0,s1
+	call	free
+	li	a0,0
+	lw	ra,12(sp)
+	lw	s1,8(sp)
+	addi	sp,sp,16
+	jr	ra
+	.size	main, .-main
@@ -0,0 +1,31 @@
+# #include <stdlib.h>
+#
+# // a[5] is in the red zone after the block, which is an invalid address if
+# // debug info is kept.
+# int main() {
+#   char *a = malloc(5);
+#   a[5] = 0;
+#   free(a);
+#   return 0;
+# }
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp,sp,-16
+	sw	ra,12(sp)
+	sw	s1,8(sp)
+	li	a0,5
+	call	malloc
+	mv	s1,a0
+	sb	zero,5(s1)
+	mv	a0,s1
+	call	free
+	li	a0,0
+	lw	ra,12(sp)
+	lw	s1,8(sp)
+	addi	sp,sp,16
+	jr	ra
+	.size	main, .-main
@@ -0,0 +1,180 @@
+# Every pseudo instruction the assembler expands, with the results checked by
+# the program itself. Returns 0, or the number of the first failed check.
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp,sp,-16
+	sw	ra,12(sp)
+	sw	s1,8(sp)
+	# nop, mv, not, neg
+	li	s1,1
+	li	a1,5
+	nop
+	mv	a0,a1
+	bne	a0,a1,.L9
+	not	a0,a1
+	li	a2,-6
+	bne	a0,a2,.L9
+	neg	a0,a1
+	li	a2,-5
+	bne	a0,a2,.L9
+	# seqz, snez, sltz, sgtz, sgt
+	li	s1,2
+	li	a2,1
+	seqz	a0,zero
+	bne	a0,a2,.L9
+	seqz	a0,a1
+	bnez	a0,.L9
+	snez	a0,a1
+	bne	a0,a2,.L9
+	li	a3,-1
+	sltz	a0,a3
+	bne	a0,a2,.L9
+	sgtz	a0,a1
+	bne	a0,a2,.L9
+	sgtz	a0,a3
+	bnez	a0,.L9
+	sgt	a0,a1,a3
+	bne	a0,a2,.L9
+	sgt	a0,a3,a1
+	bnez	a0,.L9
+	# bgt, ble, bgtu and bleu swap their operands
+	li	s1,3
+	li	a0,-1
+	li	a1,1
+	bgt	a0,a1,.L9
+	bgt	a1,a0,.L11
+	j	.L9
+.L11:	ble	a1,a0,.L9
+	ble	a0,a1,.L12
+	j	.L9
+.L12:	bgtu	a1,a0,.L9
+	bgtu	a0,a1,.L13
+	j	.L9
+.L13:	bleu	a0,a1,.L9
+	bleu	a1,a0,.L14
+	j	.L9
+.L14:
+	# beqz, bnez, bltz and bgez compare with x0 on the right, bgtz and blez
+	# on the left
+	li	s1,4
+	beqz	a1,.L9
+	bnez	zero,.L9
+	bltz	a1,.L9
+	bgez	a0,.L9
+	bgtz	zero,.L9
+	bgtz	a0,.L9
+	blez	a1,.L9
+	beqz	zero,.L1
+	j	.L9
+.L1:
+	bnez	a1,.L2
+	j	.L9
+.L2:
+	bltz	a0,.L3
+	j	.L9
+.L3:
+	bgez	zero,.L4
+	j	.L9
+.L4:
+	bgtz	a1,.L5
+	j	.L9
+.L5:
+	blez	zero,.L6
+	j	.L9
+.L6:
+	blez	a0,.L7
+	j	.L9
+.L7:
+	# j, jal, jr, jalr, call, tail, ret
+	li	s1,5
+	li	a0,0
+	jal	inc
+	call	inc
+	call	tail_inc
+	lui	t0,%hi(inc)
+	addi	t0,t0,%lo(inc)
+	jalr	t0
+	li	a2,4
+	bne	a0,a2,.L9
+	lui	t0,%hi(.L8)
+	addi	t0,t0,%lo(.L8)
+	jr	t0
+	j	.L9
+.L8:
+	# la and loads and stores of a symbol
+	li	s1,6
+	la	a0,value
+	lui	a1,%hi(value)
+	addi	a1,a1,%lo(value)
+	bne	a0,a1,.L9
+	lw	a1,value
+	li	a2,-3
+	bne	a1,a2,.L9
+	lh	a1,value
+	bne	a1,a2,.L9
+	lb	a1,value
+	bne	a1,a2,.L9
+	li	a1,0x12345678
+	sw	a1,value,t0
+	lw	a2,0(a0)
+	bne	a1,a2,.L9
+	li	a1,-2
+	sh	a1,value,t0
+	lh	a2,0(a0)
+	bne	a1,a2,.L9
+	sb	zero,value,t0
+	lw	a2,0(a0)
+	li	a1,0x1234ff00
+	bne	a1,a2,.L9
+	# li, with small and large immediates
+	li	s1,7
+	li	a0,0x10
+	addi	a1,zero,16
+	bne	a0,a1,.L9
+	li	a0,2047
+	addi	a1,zero,2047
+	bne	a0,a1,.L9
+	li	a0,-5
+	addi	a1,zero,-5
+	bne	a0,a1,.L9
+	li	a0,70000
+	lui	a1,17
+	addi	a1,a1,368
+	bne	a0,a1,.L9
+	li	a0,0x12345fff
+	lui	a1,0x12346
+	addi	a1,a1,-1
+	bne	a0,a1,.L9
+	li	a0,-2147483648
+	lui	a1,0x80000
+	bne	a0,a1,.L9
+	li	s1,0
+.L9:
+	mv	a0,s1
+	lw	ra,12(sp)
+	lw	s1,8(sp)
+	addi	sp,sp,16
+	ret
+	.size	main, .-main
+
+	.align	2
+	.type	inc, @function
+inc:
+	addi	a0,a0,1
+	ret
+	.size	inc, .-inc
+
+	.align	2
+	.type	tail_inc, @function
+tail_inc:
+	tail	inc
+	.size	tail_inc, .-tail_inc
+
+	.data
+	.align	2
+value:
+	.word	-3
@@ -0,0 +1,110 @@
+# The statements which the assembler has to split carefully: a '#' and
+# escaped quotes inside strings, labels on lines of their own, two labels on
+# one line, lines ending with CRLF (the first instruction of main and the
+# definition of crlf) and a last line without a newline.
+#
+# const char hash[] = "a#b";
+# const char quoted[] = "\"#\"\\";
+# const int seven = 7;          // labelled twice, as first and second
+# const char crlf[] = "crlf";
+# int last = 42;
+#
+# // Returns 0, or the number of the first failed check.
+# int main() {
+#   if (strlen(hash) != 3)
+#     return 1;
+#   if (hash[1] != '#')
+#     return 2;
+#   if (strlen(quoted) != 4)
+#     return 3;
+#   if (quoted[0] != '"' || quoted[3] != '\\')
+#     return 4;
+#   if (first != second || *second != 7)
+#     return 5;
+#   if (strlen(crlf) != 4)
+#     return 6;
+#   if (last != 42)
+#     return 7;
+#   return 0;
+# }
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp,sp,-16
+	sw	ra,12(sp)
+	sw	s1,8(sp)
+	li	s1,1	# check 1
+	lui	a5,%hi(.Lhash)
+	addi	a0,a5,%lo(.Lhash)
+	call	strlen
+	li	a5,3
+	bne	a0,a5,.L9
+	li	s1,2
+	lui	a5,%hi(.Lhash)
+	addi	a5,a5,%lo(.Lhash)
+	lbu	a4,1(a5)
+	li	a5,35
+	bne	a4,a5,.L9
+	li	s1,3
+	lui	a5,%hi(.Lquoted)
+	addi	a0,a5,%lo(.Lquoted)
+	call	strlen
+	li	a5,4
+	bne	a0,a5,.L9
+	li	s1,4
+	lui	a5,%hi(.Lquoted)
+	addi	a5,a5,%lo(.Lquoted)
+	lbu	a4,0(a5)
+	li	a3,34
+	bne	a4,a3,.L9
+	lbu	a4,3(a5)
+	li	a3,92
+	bne	a4,a3,.L9
+	j	.L2
+.L2:
+	li	s1,5
+	lui	a5,%hi(first)
+	addi	a4,a5,%lo(first)
+	lui	a5,%hi(second)
+	addi	a5,a5,%lo(second)
+	bne	a4,a5,.L9
+	lw	a4,0(a5)
+	li	a3,7
+	bne	a4,a3,.L9
+	li	s1,6
+	lui	a5,%hi(.Lcrlf)
+	addi	a0,a5,%lo(.Lcrlf)
+	call	strlen
+	li	a5,4
+	bne	a0,a5,.L9
+	li	s1,7
+	lui	a5,%hi(last)
+	lw	a4,%lo(last)(a5)
+	li	a5,42
+	bne	a4,a5,.L9
+	li	s1,0
+.L9:
+	mv	a0,s1
+	lw	ra,12(sp)
+	lw	s1,8(sp)
+	addi	sp,sp,16
+	jr	ra
+	.size	main, .-main
+
+	.section	.rodata
+	.align	2
+.Lhash:
+	.string	"a#b"	# a comment after a '#' in a string
+.Lquoted:	.string	"\"#\"\\"	# a label and a statement on one line
+	.align	2
+first:second:
+	.word	7
+.Lcrlf:
+	.string	"crlf"
+	.data
+	.align	2
+last:
+	.word	42
\ No newline at end of file
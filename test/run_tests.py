@@ -1,3 +1,4 @@
+import json
 import os
 import sys
 import subprocess
@@ -27,6 +28,40 @@ ravel_cmd = './ravel --oj-mode --enable-cache --timeout=30000000000 ' + \
             '>ravel.out 2>/dev/null'
 diff_cmd = 'diff test.out test.ans -q >/dev/null 2>/dev/null'
 
+# Differential mode (--differential): run every test case with both the
+# interpreter and the JIT, and require the program output and all the
+# statistics (time, instruction counts, cache hits and misses) to be identical.
+differential = '--differential' in sys.argv[1:]
+jit_cmd = './ravel --oj-mode --enable-cache --timeout=30000000000 --jit ' + \
+          '>jit.out 2>/dev/null'
+differential_diff_cmd = 'diff ravel.out jit.out -q >/dev/null 2>/dev/null && ' + \
+                        'diff ravel-test.out test.out -q >/dev/null 2>/dev/null'
+
+# Assembly mode (--asm): run the programs in test/asm which check ravel
+# themselves instead of the test cases above. The exit code of the program and
+# whether memory was leaked must be as expected, or, for a program whose
+# expected exit code is None, ravel must fail.
+asm_mode = '--asm' in sys.argv[1:]
+asm_test_cases = [
+    # (name, flags, exit code, memory leak)
+    ('heap', '', 0, False),
+    ('heap', '--keep-debug-info', 0, False),
+    ('heap_leak', '', 0, True),
+    ('heap_double_free', '', None, None),
+    ('heap_red_zone', '', 0, False),
+    ('heap_red_zone', '--keep-debug-info', None, None),
+    ('pseudo', '', 0, False),
+    ('statements', '', 0, False),
+]
+
+# Trace mode (--trace): write the instruction traces of test/asm/loop.s and of
+# a version of it which runs long enough to fill several trace blocks, with and
+# without compression. Every record decoded by ravel-trace is checked against
+# the instructions printed by --print-instructions: its pc (the same pc is
+# always the same instruction, and the control flow is followed), the address
+# of a memory access and the register written.
+trace_mode = '--trace' in sys.argv[1:]
+
 color_red = "\033[0;31m"
 color_green = "\033[0;32m"
 color_none = "\033[0m"
@@ -37,6 +72,128 @@ def execute(cmd):
     return subprocess.run(cmd, shell=True, executable="/bin/bash")
 
 
+def run_asm_test(name, flags, exit_code, leak):
+    res = subprocess.run('./ravel --stats-format=json %s asm/%s.s' %
+                         (flags, name), shell=True, executable="/bin/bash",
+                         stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                         stderr=subprocess.DEVNULL, universal_newlines=True)
+    if exit_code is None:
+        return res.returncode != 0
+    if res.returncode:
+        return False
+    stats = json.loads(res.stdout.splitlines()[-1])
+    return stats['exitCode'] == exit_code and stats['memoryLeak'] == leak
+
+
+# Return [(instruction, (reg, old, new) or None)] from the output of
+# --print-instructions
+def parse_printed_instructions(lines):
+    insts = []
+    started = False
+    for line in lines:
+        if line.startswith('Build finished'):
+            started = True
+        elif not started or not line.strip():
+            continue
+        elif line.startswith('Interpretation finished'):
+            break
+        elif line.startswith('\t\t# '):
+            words = line.split()
+            if words[1].endswith(':'):
+                insts[-1] = (insts[-1][0], (words[1][:-1], int(words[2]),
+                                            int(words[4])))
+        else:
+            insts.append((line.split('#')[0].strip(), None))
+    return insts
+
+
+# Return [(pc, (reg, value) or None, address or None)] from the output of
+# ravel-trace
+def parse_trace(lines):
+    records = []
+    for line in lines:
+        fields = line.rstrip('\n').split('\t')
+        reg, addr = None, None
+        for field in fields[1:]:
+            if field.startswith('['):
+                addr = int(field[1:-1], 16)
+            else:
+                name, value = field.split(' = ')
+                reg = (name, int(value))
+        records.append((int(fields[0].split()[0], 16), reg, addr))
+    return records
+
+
+def check_trace(insts, records):
+    if len(insts) != len(records):
+        return 'got %d records for %d instructions' % (len(records),
+                                                       len(insts))
+    regs = {}
+    inst_at = {}
+    # the offset printed for jal is not in bytes
+    jal_targets = {}
+    for i, ((inst, write), (pc, reg, addr)) in enumerate(zip(insts, records)):
+        if inst_at.setdefault(pc, inst) != inst:
+            return 'record %d: pc %#x is also %s' % (i, pc, inst_at[pc])
+        op, *operands = inst.replace(',', ' ').split()
+        if i + 1 < len(records):
+            next_pc = records[i + 1][0]
+            if op in ['beq', 'bne', 'blt', 'bge', 'bltu', 'bgeu']:
+                targets = [pc + 4, pc + int(operands[-1])]
+            elif op == 'jal':
+                targets = [jal_targets.setdefault(pc, next_pc)]
+            elif op == 'jalr':
+                targets = [next_pc]
+            else:
+                targets = [pc + 4]
+            if next_pc not in targets:
+                return 'record %d: %s at %#x is followed by %#x' % (i, inst,
+                                                                    pc, next_pc)
+        expected_addr = None
+        if op in ['lb', 'lh', 'lw', 'lbu', 'lhu', 'sb', 'sh', 'sw']:
+            offset, base = operands[-1][:-1].split('(')
+            expected_addr = (regs.get(base, 0) + int(offset)) % 2**32
+        if addr != expected_addr:
+            return 'record %d: %s accesses %s' % (i, inst, addr)
+        if write:
+            name, old, new = write
+            regs[name] = new
+        expected_reg = (name, new) if write and name != 'zero' else None
+        if reg != expected_reg:
+            return 'record %d: %s writes %s' % (i, inst, reg)
+    return None
+
+
+def run_trace_test(src):
+    with open('trace.s', 'w') as f:
+        f.write(src)
+    printed = subprocess.run('./ravel --print-instructions trace.s',
+                             shell=True, executable="/bin/bash",
+                             stdin=subprocess.DEVNULL,
+                             stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                             universal_newlines=True)
+    if printed.returncode:
+        return ['ravel failed'] * 2
+    insts = parse_printed_instructions(printed.stderr.splitlines())
+    errors = []
+    for compress in [False, True]:
+        res = execute('./ravel --trace=trace.bin %s trace.s >/dev/null 2>&1' %
+                      ('--trace-compress' if compress else ''))
+        decoded = subprocess.run('./ravel-trace trace.bin', shell=True,
+                                 executable="/bin/bash",
+                                 stdout=subprocess.PIPE,
+                                 universal_newlines=True)
+        if res.returncode or decoded.returncode:
+            errors.append('ravel or ravel-trace failed')
+        elif not compress and len(insts) > 100000 and \
+                os.path.getsize('trace.bin') < 2 * (1 << 20):
+            errors.append('the trace does not span several blocks')
+        else:
+            errors.append(check_trace(insts,
+                                      parse_trace(decoded.stdout.splitlines())))
+    return errors
+
+
 # build
 directory = os.path.dirname(os.path.abspath(__file__))
 os.chdir(os.path.join(directory, '..'))
@@ -48,6 +205,51 @@ if os.system('cmake .. && make'):
 os.chdir(directory)
 os.system('cp ../build/src/ravel ./')
 
+if asm_mode:
+    print("%d assembly test cases." % len(asm_test_cases))
+    failed_test_cases = []
+    for name, flags, exit_code, leak in asm_test_cases:
+        identifier = (name + ' ' + flags).strip()
+        if run_asm_test(name, flags, exit_code, leak):
+            print(color_green + identifier + color_none)
+        else:
+            print(color_red + identifier + color_none)
+            failed_test_cases.append(identifier)
+    execute('rm ravel')
+    if len(failed_test_cases) == 0:
+        print('Passed all test cases')
+        exit(0)
+    print("Failed: ")
+    for test_case in failed_test_cases:
+        print(test_case)
+    exit(1)
+
+if trace_mode:
+    os.system('cp ../build/src/ravel-trace ./')
+    with open('asm/loop.s') as f:
+        loop = f.read()
+    # about 550k instructions instead of 116, whose trace is more than twice
+    # the size of a block
+    long_loop = loop.replace('li      a5,9\n', 'li      a5,49999\n')
+    failed_test_cases = []
+    for name, src in [('loop', loop), ('long loop', long_loop)]:
+        errors = run_trace_test(src)
+        for error, suffix in zip(errors, ['', ' (compressed)']):
+            identifier = name + suffix
+            if error is None:
+                print(color_green + identifier + color_none)
+            else:
+                print(color_red + identifier + ': ' + error + color_none)
+                failed_test_cases.append(identifier)
+    execute('rm ravel ravel-trace trace.s trace.bin')
+    if len(failed_test_cases) == 0:
+        print('Passed all test cases')
+        exit(0)
+    print("Failed: ")
+    for test_case in failed_test_cases:
+        print(test_case)
+    exit(1)
+
 # test
 print("%d test cases." % len(test_cases))
 total_time_used = 0
@@ -67,6 +269,18 @@ for test_case in test_cases:
             end = time.time()
             time_used = end - start
             total_time_used += time_used
+            if differential:
+                execute('cp test.out ravel-test.out')
+                jit_res = execute(jit_cmd)
+                mismatch = jit_res.returncode != ravel_res.returncode or \
+                    execute(differential_diff_cmd).returncode
+                execute('mv ravel-test.out test.out')
+                if mismatch:
+                    print(color_red + identifier + '(JIT mismatch)' +
+                          color_none, end='\t', flush=True)
+                    failed_test_cases.append(test_case + '(' + identifier +
+                                             ', JIT)')
+                    continue
             if ravel_res.returncode:
                 print(color_red + identifier + '(RE)' + color_none,
                       end='\t', flush=True)
@@ -91,6 +305,8 @@ for test_case in test_cases:
     print('')
 
 execute('rm ravel test.ans test.c test.in test.out test.s ravel.out')
+if differential:
+    execute('rm jit.out')
 print('total time used = %d s' % total_time_used)
 if len(failed_test_cases) == 0:
     print('Passed all test cases')